@@ -0,0 +1,119 @@
+#include <stm32.h>
+#include "board.h"
+#include "consts.h"
+#include "peripherals.hpp"
+
+
+using namespace peripherals;
+
+
+namespace {
+
+
+using ConsoleTx = AlternatePin<Port::A, 2, Signal::Usart2Tx, OutputType::PushPull, Speed::Fast>;
+using ConsoleRx = AlternatePin<Port::A, 3, Signal::Usart2Rx, OutputType::PushPull, Speed::Fast, Pull::Up>;
+using LoggerTx = AlternatePin<Port::A, 9, Signal::Usart1Tx, OutputType::PushPull, Speed::Fast>;
+using LiveTx = AlternatePin<Port::A, 11, Signal::Usart6Tx, OutputType::PushPull, Speed::Fast>;
+using SensorScl = AlternatePin<Port::B, 8, Signal::I2c1Scl, OutputType::OpenDrain>;
+using SensorSda = AlternatePin<Port::B, 9, Signal::I2c1Sda, OutputType::OpenDrain>;
+using ExtraSensorScl = AlternatePin<Port::B, 10, Signal::I2c2Scl, OutputType::OpenDrain>;
+using ExtraSensorSda = AlternatePin<Port::B, 3, Signal::I2c2Sda, OutputType::OpenDrain>;
+using HeartbeatLed = OutputPin<Port::A, HEARTBEAT_LED_PIN>;
+using SensorInt1 = InputPin<Port::A, LIS35DE_INT1_PIN>;
+using SensorInt2 = InputPin<Port::A, LIS35DE_INT2_PIN>;
+
+
+using Console = Usart<2, ConsoleTx, ConsoleRx>;
+using Logger = Usart<1, LoggerTx>;
+using Live = Usart<6, LiveTx>;
+using SensorBus = I2c<1, SensorScl, SensorSda>;
+using ExtraSensorBus = I2c<2, ExtraSensorScl, ExtraSensorSda>;
+
+
+static_assert(wired<Console, Logger, Live, SensorBus, ExtraSensorBus>, "incomplete wiring");
+
+
+using ConsoleTxDma = Dma<1, 6, Console::tx_request>;
+using ConsoleRxDma = Dma<1, 5, Console::rx_request>;
+using LoggerDma = Dma<2, 7, Logger::tx_request>;
+using LiveDma = Dma<2, 6, Live::tx_request>;
+
+
+/* The C code and the interrupt handlers name the streams directly */
+static_assert(ConsoleTxDma::address == DMA1_Stream6_BASE && ConsoleRxDma::address == DMA1_Stream5_BASE,
+              "the console uses DMA1 streams 6 and 5");
+static_assert(LoggerDma::address == DMA2_Stream7_BASE, "the logger uses DMA2 stream 7");
+static_assert(LiveDma::address == DMA2_Stream6_BASE, "the live sink uses DMA2 stream 6");
+static_assert(ConsoleTxDma::channel_bits == ConsoleRxDma::channel_bits,
+              "the console streams share CONSOLE_dma_channel_bits()");
+
+
+using PortA = PortConfiguration<Port::A,
+                                ConsoleTx,
+                                ConsoleRx,
+                                LoggerTx,
+                                LiveTx,
+                                HeartbeatLed,
+                                SensorInt1,
+                                SensorInt2>;
+
+#if SENSORS_NUMBER >= 3
+using PortB = PortConfiguration<Port::B, SensorScl, SensorSda, ExtraSensorScl, ExtraSensorSda>;
+#else
+using PortB = PortConfiguration<Port::B, SensorScl, SensorSda>;
+#endif
+
+
+} /* namespace */
+
+
+void PINS_configure(void) {
+    PortA::configure();
+    PortB::configure();
+}
+
+
+void EXTI_configure(void) {
+    ExtiLine<SensorInt1, Trigger::Rising>::configure();
+    ExtiLine<SensorInt2, Trigger::Rising>::configure();
+}
+
+
+uint32_t CONSOLE_brr(uint32_t baud_rate) {
+    return Console::brr(PCLK_HZ, baud_rate);
+}
+
+
+uint32_t LOGGER_brr(uint32_t baud_rate) {
+    return Logger::brr(PCLK_HZ, baud_rate);
+}
+
+
+uint32_t LIVE_brr(uint32_t baud_rate) {
+    return Live::brr(PCLK_HZ, baud_rate);
+}
+
+
+uint32_t CONSOLE_dma_channel_bits(void) {
+    return ConsoleTxDma::channel_bits;
+}
+
+
+uint32_t LOGGER_dma_channel_bits(void) {
+    return LoggerDma::channel_bits;
+}
+
+
+uint32_t LIVE_dma_channel_bits(void) {
+    return LiveDma::channel_bits;
+}
+
+
+uint32_t SENSOR_BUS_ccr(void) {
+    return SensorBus::ccr(PCLK_HZ / 1000000, I2C_SPEED_HZ);
+}
+
+
+uint32_t SENSOR_BUS_trise(void) {
+    return SensorBus::trise(PCLK_HZ / 1000000);
+}
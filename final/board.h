@@ -0,0 +1,83 @@
+#ifndef BOARD_H
+#define BOARD_H
+
+
+/* Pins and DMA streams the program uses, set up by board.cpp from
+ * compile-time descriptions in peripherals.hpp; a pin without the
+ * alternate function or a stream not serving its request fails to
+ * compile there. The C setup code takes the USART, DMA and I2C register
+ * values computed from the descriptions through the functions below.
+ */
+
+
+/* The core, APB1 and APB2 all run from the 16 MHz HSI */
+#define     PCLK_HZ                       16000000U
+
+
+#define     I2C_SPEED_HZ                     100000
+
+
+/* Accelerometers sampled, the first SENSORS_NUMBER of them as set with
+ * make SENSORS=<n>, each as the I2C controller and address: the on-board
+ * LIS35DE, whose interrupt pins drive the events, one with SDO high on
+ * the same I2C1 and one on I2C2 (SCL PB10, SDA PB3). I2C3 has its SCL
+ * only on PA8, which INT2 takes on this board.
+ */
+#ifndef SENSORS_NUMBER
+#define     SENSORS_NUMBER                        1
+#endif
+
+#if SENSORS_NUMBER < 1 || SENSORS_NUMBER > 3
+#error "SENSORS_NUMBER must be 1, 2 or 3"
+#endif
+
+#define     SENSOR_DEVICES    {{1, LIS35DE_ADDR}, \
+                               {1, LIS35DE_ADDR_SDO_HIGH}, \
+                               {2, LIS35DE_ADDR}}
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* Configures all GPIO pins, writing each register of a port once; the
+ * GPIO ports must be clocked
+ */
+void PINS_configure(void);
+
+
+/* Routes the LIS35DE interrupt pins to their EXTI lines, rising edge;
+ * SYSCFG must be clocked
+ */
+void EXTI_configure(void);
+
+
+/* BRR values at the baud rate of USART2, the console, of USART1, the
+ * logger sink, and of USART6, the live sink
+ */
+uint32_t CONSOLE_brr(uint32_t);
+uint32_t LOGGER_brr(uint32_t);
+uint32_t LIVE_brr(uint32_t);
+
+
+/* Channel bits of the stream CR registers: the console on DMA1 streams
+ * 6 (TX) and 5 (RX), the logger on DMA2 stream 7 and the live sink on
+ * DMA2 stream 6
+ */
+uint32_t CONSOLE_dma_channel_bits(void);
+uint32_t LOGGER_dma_channel_bits(void);
+uint32_t LIVE_dma_channel_bits(void);
+
+
+/* CCR and TRISE of the sensor buses in standard mode at I2C_SPEED_HZ */
+uint32_t SENSOR_BUS_ccr(void);
+uint32_t SENSOR_BUS_trise(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* BOARD_H */
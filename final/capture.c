@@ -0,0 +1,178 @@
+#include <stm32.h>
+#include "capture.h"
+#include "ramfunc.h"
+
+
+/* Ring of raw samples; positions are free-running and wrap only when
+ * used as indices
+ */
+static capture_sample_t ring[CAPTURE_BUFFER_SAMPLES];
+static volatile uint32_t write_position;
+static volatile uint32_t read_position;
+
+
+static capture_state_t state;
+static uint32_t recorded_samples;
+static uint32_t overflows;
+static uint16_t block_sequence;
+
+
+/* First sample seen while armed, the reference for the trigger */
+static int8_t baseline[3];
+static uint8_t baseline_valid;
+
+
+static uint8_t block[CAPTURE_BLOCK_SIZE];
+
+
+void capture_start(uint8_t triggered) {
+    write_position = 0;
+    read_position = 0;
+
+    recorded_samples = 0;
+    overflows = 0;
+    block_sequence = 0;
+    baseline_valid = 0;
+
+    state = triggered ? CAPTURE_ARMED : CAPTURE_RECORDING;
+}
+
+
+void capture_stop(void) {
+    if (state == CAPTURE_ARMED) {
+        state = CAPTURE_IDLE;
+    } else if (state == CAPTURE_RECORDING) {
+        state = CAPTURE_DRAINING;
+    }
+}
+
+
+capture_state_t capture_state(void) {
+    return state;
+}
+
+
+RAMFUNC
+uint8_t capture_is_sampling(void) {
+    return state == CAPTURE_ARMED || state == CAPTURE_RECORDING;
+}
+
+
+static
+uint8_t exceeds_threshold(int8_t value, int8_t reference) {
+    int32_t difference = (int32_t) value - reference;
+
+    return difference > CAPTURE_TRIGGER_THRESHOLD ||
+           difference < -CAPTURE_TRIGGER_THRESHOLD;
+}
+
+
+static
+uint8_t is_triggered(int8_t x, int8_t y, int8_t z) {
+    if (!baseline_valid) {
+        baseline[0] = x;
+        baseline[1] = y;
+        baseline[2] = z;
+        baseline_valid = 1;
+
+        return 0;
+    }
+
+    return exceeds_threshold(x, baseline[0]) ||
+           exceeds_threshold(y, baseline[1]) ||
+           exceeds_threshold(z, baseline[2]);
+}
+
+
+RAMFUNC
+void capture_store(uint32_t timestamp, int8_t x, int8_t y, int8_t z) {
+    if (state == CAPTURE_ARMED && is_triggered(x, y, z)) {
+        state = CAPTURE_RECORDING;
+    }
+
+    if (state != CAPTURE_RECORDING) {
+        return;
+    }
+
+    if (write_position - read_position == CAPTURE_BUFFER_SAMPLES) {
+        overflows++;
+    } else {
+        capture_sample_t *sample = &ring[write_position % CAPTURE_BUFFER_SAMPLES];
+
+        sample->timestamp = timestamp;
+        sample->x = x;
+        sample->y = y;
+        sample->z = z;
+        sample->flags = recorded_samples == 0;
+
+        write_position++;
+    }
+
+    if (++recorded_samples == CAPTURE_LENGTH_SAMPLES) {
+        state = CAPTURE_DRAINING;
+    }
+}
+
+
+static
+void put_sample(uint8_t *position, const capture_sample_t *sample) {
+    position[0] = sample->timestamp;
+    position[1] = sample->timestamp >> 8;
+    position[2] = sample->timestamp >> 16;
+    position[3] = sample->timestamp >> 24;
+    position[4] = sample->x;
+    position[5] = sample->y;
+    position[6] = sample->z;
+    position[7] = sample->flags;
+}
+
+
+uint32_t capture_build_block(const uint8_t **block_start) {
+    uint32_t pending = write_position - read_position;
+    uint8_t kind = CAPTURE_BLOCK_KIND_DATA;
+
+    if (pending < CAPTURE_BLOCK_SAMPLES) {
+        if (state != CAPTURE_DRAINING) {
+            return 0;
+        }
+
+        /* The last, possibly empty, block closes the capture */
+        kind = CAPTURE_BLOCK_KIND_END;
+        state = CAPTURE_IDLE;
+    } else {
+        pending = CAPTURE_BLOCK_SAMPLES;
+    }
+
+    block[0] = CAPTURE_BLOCK_SYNC_0;
+    block[1] = CAPTURE_BLOCK_SYNC_1;
+    block[2] = kind;
+    block[3] = pending;
+    block[4] = block_sequence;
+    block[5] = block_sequence >> 8;
+
+    uint8_t *position = block + CAPTURE_BLOCK_HEADER_SIZE;
+
+    for (uint32_t i = 0; i < pending; ++i) {
+        put_sample(position, &ring[read_position % CAPTURE_BUFFER_SAMPLES]);
+        read_position++;
+        position += 8;
+    }
+
+    uint8_t checksum = 0;
+
+    for (uint8_t *byte = block + 2; byte < position; ++byte) {
+        checksum += *byte;
+    }
+
+    *position++ = checksum;
+
+    block_sequence++;
+    *block_start = block;
+
+    return position - block;
+}
+
+
+uint32_t capture_overflows(void) {
+    return overflows;
+}
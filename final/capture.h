@@ -0,0 +1,81 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+
+/* Number of samples held by the SRAM ring, 64 KB at 8 bytes per sample */
+#define CAPTURE_BUFFER_SAMPLES                   8192
+
+/* Maximum number of samples sent in one block */
+#define CAPTURE_BLOCK_SAMPLES                      64
+
+/* Number of samples recorded after the capture starts, 10 s at 400 Hz */
+#define CAPTURE_LENGTH_SAMPLES                   4000
+
+/* Deviation from the first armed sample that starts a triggered capture */
+#define CAPTURE_TRIGGER_THRESHOLD                  20
+
+
+/* Block framing: sync bytes, kind, sample count, block sequence number
+ * (little endian), samples, 8-bit sum of everything after the sync bytes
+ */
+#define CAPTURE_BLOCK_SYNC_0                     0xA5
+#define CAPTURE_BLOCK_SYNC_1                     0x5A
+#define CAPTURE_BLOCK_KIND_DATA                   'B'
+#define CAPTURE_BLOCK_KIND_END                    'E'
+#define CAPTURE_BLOCK_HEADER_SIZE                   6
+#define CAPTURE_BLOCK_SIZE                        (CAPTURE_BLOCK_HEADER_SIZE + \
+                                                   CAPTURE_BLOCK_SAMPLES * 8 + 1)
+
+
+/* Raw sample as stored in the ring and sent in blocks; the timestamp is
+ * the value of the core cycle counter at the start of the read
+ */
+typedef struct {
+    uint32_t timestamp;
+    int8_t x;
+    int8_t y;
+    int8_t z;
+    uint8_t flags;
+} capture_sample_t;
+
+
+typedef enum {
+    CAPTURE_IDLE,
+    CAPTURE_ARMED,
+    CAPTURE_RECORDING,
+    CAPTURE_DRAINING
+} capture_state_t;
+
+
+/* Starts recording at once or, when the argument is non-zero, arms the
+ * threshold trigger
+ */
+void capture_start(uint8_t);
+
+
+/* Stops recording; samples already in the ring are still drained */
+void capture_stop(void);
+
+
+capture_state_t capture_state(void);
+
+
+/* Returns non-zero while the sampler should run at the capture rate */
+uint8_t capture_is_sampling(void);
+
+
+void capture_store(uint32_t, int8_t, int8_t, int8_t);
+
+
+/* Builds the next block when a full one is pending, or a partial one after
+ * recording has ended; returns its length or 0 when there is nothing to send.
+ * The block stays valid until the next call.
+ */
+uint32_t capture_build_block(const uint8_t **);
+
+
+/* Number of samples lost because the ring was full */
+uint32_t capture_overflows(void);
+
+
+#endif /* CAPTURE_H */
@@ -0,0 +1,200 @@
+#include <stm32.h>
+#include "command_parser.h"
+#include "messages_queue.h"
+
+
+/* Longest numeric argument, in digits; longer ones make the line invalid */
+#define     NUMBER_MAX_DIGITS                     9
+
+
+typedef struct {
+    const char *word;
+    uint32_t value;
+} word_t;
+
+
+static const word_t KEYWORDS[] = {
+        {"PERIOD",   COMMAND_PERIOD},
+        {"ODR",      COMMAND_ODR},
+        {"AXES",     COMMAND_AXES},
+        {"FORMAT",   COMMAND_FORMAT},
+        {"POLICY",   COMMAND_POLICY},
+        {"COUNTERS", COMMAND_COUNTERS},
+        {"CYCLES",   COMMAND_CYCLES},
+        {"SUMMARY",  COMMAND_SUMMARY}
+};
+
+
+static const word_t FORMATS[] = {
+        {"DEC", COMMAND_FORMAT_DECIMAL},
+        {"HEX", COMMAND_FORMAT_HEXADECIMAL}
+};
+
+
+static const word_t POLICIES[] = {
+        {"NEWEST",   QUEUE_POLICY_DROP_NEWEST},
+        {"OLDEST",   QUEUE_POLICY_DROP_OLDEST},
+        {"COALESCE", QUEUE_POLICY_COALESCE}
+};
+
+
+#define     WORDS_NUMBER(words)    (sizeof(words) / sizeof((words)[0]))
+
+
+static
+uint8_t find_word(const word_t *words, uint32_t words_number,
+                  const char *text, uint32_t *value) {
+    for (uint32_t i = 0; i < words_number; ++i) {
+        const char *word = words[i].word;
+        uint32_t j = 0;
+
+        while (word[j] != '\0' && word[j] == text[j]) {
+            ++j;
+        }
+
+        if (word[j] == '\0' && text[j] == '\0') {
+            *value = words[i].value;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
+static
+uint8_t is_end_of_line(char byte) {
+    return byte == '\r' || byte == '\n';
+}
+
+
+void command_parser_reset(command_parser_t *parser) {
+    parser->state = PARSER_KEYWORD;
+    parser->kind = COMMAND_INVALID;
+    parser->word_length = 0;
+    parser->number = 0;
+    parser->digits = 0;
+}
+
+
+/* Appends the byte to the current word; returns 0 when it does not fit */
+static
+uint8_t append_to_word(command_parser_t *parser, char byte) {
+    if (parser->word_length == COMMAND_WORD_SIZE - 1) {
+        return 0;
+    }
+
+    parser->word[parser->word_length++] = byte;
+
+    return 1;
+}
+
+
+/* Consumes one byte of the argument; returns 0 when it cannot belong to
+ * an argument of the command
+ */
+static
+uint8_t parse_argument(command_parser_t *parser, char byte) {
+    switch (parser->kind) {
+        case COMMAND_PERIOD:
+        case COMMAND_ODR:
+        case COMMAND_SUMMARY:
+            if (byte < '0' || byte > '9' || parser->digits == NUMBER_MAX_DIGITS) {
+                return 0;
+            }
+
+            parser->number = parser->number * 10 + (byte - '0');
+            parser->digits++;
+            return 1;
+        case COMMAND_AXES:
+            if (byte < 'X' || byte > 'Z' || (parser->number & (COMMAND_AXIS_X << (byte - 'X')))) {
+                return 0;
+            }
+
+            parser->number |= COMMAND_AXIS_X << (byte - 'X');
+            parser->digits++;
+            return 1;
+        case COMMAND_FORMAT:
+        case COMMAND_POLICY:
+            return append_to_word(parser, byte);
+        default:
+            return 0;
+    }
+}
+
+
+/* Builds the command at the end of the line */
+static
+void finish_command(command_parser_t *parser, command_t *command) {
+    command->kind = COMMAND_INVALID;
+    command->argument = 0;
+
+    parser->word[parser->word_length] = '\0';
+
+    if (parser->state == PARSER_KEYWORD) {
+        uint32_t kind;
+
+        if (parser->word_length == 1) {
+            command->kind = COMMAND_CHARACTER;
+            command->argument = (uint8_t) parser->word[0];
+        } else if (find_word(KEYWORDS, WORDS_NUMBER(KEYWORDS), parser->word, &kind) &&
+                   (kind == COMMAND_COUNTERS || kind == COMMAND_CYCLES)) {
+            command->kind = kind;
+        }
+    } else if (parser->state == PARSER_ARGUMENT) {
+        uint8_t found = 0;
+
+        if (parser->kind == COMMAND_FORMAT) {
+            found = find_word(FORMATS, WORDS_NUMBER(FORMATS), parser->word, &command->argument);
+        } else if (parser->kind == COMMAND_POLICY) {
+            found = find_word(POLICIES, WORDS_NUMBER(POLICIES), parser->word, &command->argument);
+        } else if (parser->digits > 0) {
+            command->argument = parser->number;
+            found = 1;
+        }
+
+        if (found) {
+            command->kind = parser->kind;
+        }
+    }
+}
+
+
+uint8_t command_parse_byte(command_parser_t *parser, char byte, command_t *command) {
+    if (is_end_of_line(byte)) {
+        uint8_t is_empty = parser->state == PARSER_KEYWORD && parser->word_length == 0;
+
+        if (!is_empty) {
+            finish_command(parser, command);
+        }
+
+        command_parser_reset(parser);
+
+        return !is_empty;
+    }
+
+    if (parser->state == PARSER_KEYWORD) {
+        if (byte == ' ') {
+            uint32_t kind;
+
+            parser->word[parser->word_length] = '\0';
+
+            if (find_word(KEYWORDS, WORDS_NUMBER(KEYWORDS), parser->word, &kind) &&
+                kind != COMMAND_COUNTERS && kind != COMMAND_CYCLES) {
+                parser->kind = kind;
+                parser->word_length = 0;
+                parser->state = PARSER_ARGUMENT;
+            } else {
+                parser->state = PARSER_DISCARD;
+            }
+        } else if (!append_to_word(parser, byte)) {
+            parser->state = PARSER_DISCARD;
+        }
+    } else if (parser->state == PARSER_ARGUMENT) {
+        if (!parse_argument(parser, byte)) {
+            parser->state = PARSER_DISCARD;
+        }
+    }
+
+    return 0;
+}
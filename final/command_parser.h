@@ -0,0 +1,87 @@
+#ifndef COMMAND_PARSER_H
+#define COMMAND_PARSER_H
+
+
+/* Incremental parser of the text commands received on USART2. Bytes are
+ * fed one at a time as the RX DMA delivers them, so a command may arrive
+ * split across any number of transfers. A command is a line ended by CR
+ * or LF:
+ *
+ *   PERIOD <us>                  sampling period in microseconds
+ *   ODR <100|400>                accelerometer output data rate in Hz
+ *   AXES <X|Y|Z...>              axes reported in the samples
+ *   FORMAT <DEC|HEX>             encoding of the sample values
+ *   POLICY <NEWEST|OLDEST|COALESCE>  queue overflow policy
+ *   COUNTERS                     query of the counters
+ *   CYCLES                       query of the worst-case handler cycles
+ *   SUMMARY <ms>                 one statistics record per window instead
+ *                                of every sample, 0 for every sample
+ *
+ * A line holding a single character is one of the single-character
+ * commands accepted before.
+ */
+
+
+#define COMMAND_WORD_SIZE                           9
+
+
+typedef enum {
+    COMMAND_INVALID,
+    COMMAND_CHARACTER,
+    COMMAND_PERIOD,
+    COMMAND_ODR,
+    COMMAND_AXES,
+    COMMAND_FORMAT,
+    COMMAND_POLICY,
+    COMMAND_COUNTERS,
+    COMMAND_CYCLES,
+    COMMAND_SUMMARY
+} command_kind_t;
+
+
+/* Bits of the argument of COMMAND_AXES */
+#define COMMAND_AXIS_X                           0x01
+#define COMMAND_AXIS_Y                           0x02
+#define COMMAND_AXIS_Z                           0x04
+
+
+/* Arguments of COMMAND_FORMAT, the argument of COMMAND_POLICY is
+ * a queue_policy_t
+ */
+#define COMMAND_FORMAT_DECIMAL                      0
+#define COMMAND_FORMAT_HEXADECIMAL                  1
+
+
+typedef struct {
+    command_kind_t kind;
+    uint32_t argument;
+} command_t;
+
+
+typedef enum {
+    PARSER_KEYWORD,
+    PARSER_ARGUMENT,
+    PARSER_DISCARD
+} parser_state_t;
+
+
+typedef struct {
+    parser_state_t state;
+    command_kind_t kind;
+    char word[COMMAND_WORD_SIZE];
+    uint32_t word_length;
+    uint32_t number;
+    uint32_t digits;
+} command_parser_t;
+
+
+void command_parser_reset(command_parser_t *);
+
+
+/* Feeds the next received byte; returns 1 and fills the command when the
+ * byte ends a non-empty line, with COMMAND_INVALID for malformed ones
+ */
+uint8_t command_parse_byte(command_parser_t *, char, command_t *);
+
+
+#endif /* COMMAND_PARSER_H */
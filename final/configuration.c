@@ -1,65 +1,37 @@
-#include <gpio.h>
 #include <stm32.h>
-#include <delay.h>
+#include "board.h"
 #include "consts.h"
 #include "configuration.h"
+#include "i2c.h"
+#include "priorities.h"
+#include "ramfunc.h"
+#include "timers.h"
 
 
 
 /* Macros for USART configuration    */
 
 #define    BAUD_RATE              9600U
-#define    HSI_HZ             16000000U
-#define    PCLK1_HZ              HSI_HZ
 
 
 
-/* Macros for I2C configuration       */
+/* Macros for condition awaiting, in milliseconds */
 
-#define    I2C_SPEED_HZ           100000
-#define    PCLK1_MHZ                  16
-#define    CTRL_REG1_VALUE    0b01000111
-#define    CTRL_REG3_VALUE    0b00000100
-
-
-
-/* Macro for condition awaiting       */
-
-#define     WAIT_MAX             1000000
-
-
-
-/* Macros for TIM configuration       */
-
-#define     PSC_VALUE                400
-#define     ARR_VALUE               1000
+#define     WAIT_MAX_MS               10
+#define     REGISTER_WRITE_DELAY_MS   10
 
 
 void USART_configure(void) {
-    GPIOafConfigure(GPIOA,
-                    2,
-                    GPIO_OType_PP,
-                    GPIO_Fast_Speed,
-                    GPIO_PuPd_NOPULL,
-                    GPIO_AF_USART2);
-
-    GPIOafConfigure(GPIOA,
-                    3,
-                    GPIO_OType_PP,
-                    GPIO_Fast_Speed,
-                    GPIO_PuPd_UP,
-                    GPIO_AF_USART2);
-
-    USART2->CR1 = USART_CR1_RE | USART_CR1_TE;
+    USART2->CR1 = USART_CR1_RE | USART_CR1_TE | USART_CR1_IDLEIE;
     USART2->CR2 = 0;
 
-    USART2->BRR = (PCLK1_HZ + (BAUD_RATE / 2U)) / BAUD_RATE;
+    USART2->BRR = CONSOLE_brr(BAUD_RATE);
     USART2->CR3 = USART_CR3_DMAT | USART_CR3_DMAR;
 }
 
 
 void DMA_configure() {
-    DMA1_Stream6->CR = 4U << 25 |
+    DMA1_Stream6->CR = CONSOLE_dma_channel_bits() |
                        DMA_SxCR_PL_1 |
                        DMA_SxCR_MINC |
                        DMA_SxCR_DIR_0 |
@@ -68,115 +40,195 @@ void DMA_configure() {
     DMA1_Stream6->PAR = (uint32_t) & USART2->DR;
 
     DMA1->HIFCR = DMA_HIFCR_CTCIF6;
+
+    DMA1_Stream5->CR = CONSOLE_dma_channel_bits() |
+                       DMA_SxCR_PL_1 |
+                       DMA_SxCR_MINC |
+                       DMA_SxCR_CIRC |
+                       DMA_SxCR_HTIE |
+                       DMA_SxCR_TCIE;
+
+    DMA1_Stream5->PAR = (uint32_t) & USART2->DR;
+
+    DMA1->HIFCR = DMA_HIFCR_CHTIF5 | DMA_HIFCR_CTCIF5;
 }
 
 
 void NVIC_configure() {
+    NVIC_SetPriority(I2C1_EV_IRQn, PRIORITY_I2C);
+    NVIC_SetPriority(I2C1_ER_IRQn, PRIORITY_I2C);
+    NVIC_SetPriority(I2C2_EV_IRQn, PRIORITY_I2C);
+    NVIC_SetPriority(I2C2_ER_IRQn, PRIORITY_I2C);
+    NVIC_SetPriority(I2C3_EV_IRQn, PRIORITY_I2C);
+    NVIC_SetPriority(I2C3_ER_IRQn, PRIORITY_I2C);
+    NVIC_SetPriority(TIM3_IRQn, PRIORITY_SAMPLING_TIMER);
+    NVIC_SetPriority(SysTick_IRQn, PRIORITY_SYSTICK);
+    NVIC_SetPriority(DMA1_Stream6_IRQn, PRIORITY_USART_TX_DMA);
+    NVIC_SetPriority(DMA2_Stream6_IRQn, PRIORITY_USART_TX_DMA);
+    NVIC_SetPriority(DMA2_Stream7_IRQn, PRIORITY_USART_TX_DMA);
+    NVIC_SetPriority(USART2_IRQn, PRIORITY_USART_RX);
+    NVIC_SetPriority(DMA1_Stream5_IRQn, PRIORITY_USART_RX);
+    NVIC_SetPriority(EXTI1_IRQn, PRIORITY_ACCELEROMETER_INT);
+    NVIC_SetPriority(EXTI9_5_IRQn, PRIORITY_ACCELEROMETER_INT);
+    NVIC_SetPriority(PendSV_IRQn, PRIORITY_DEFERRED_WORK);
+
     NVIC_EnableIRQ(DMA1_Stream6_IRQn);
+    NVIC_EnableIRQ(DMA2_Stream6_IRQn);
+    NVIC_EnableIRQ(DMA2_Stream7_IRQn);
     NVIC_EnableIRQ(I2C1_EV_IRQn);
+    NVIC_EnableIRQ(I2C1_ER_IRQn);
+    NVIC_EnableIRQ(I2C2_EV_IRQn);
+    NVIC_EnableIRQ(I2C2_ER_IRQn);
+    NVIC_EnableIRQ(I2C3_EV_IRQn);
+    NVIC_EnableIRQ(I2C3_ER_IRQn);
     NVIC_EnableIRQ(TIM3_IRQn);
+    NVIC_EnableIRQ(USART2_IRQn);
+    NVIC_EnableIRQ(DMA1_Stream5_IRQn);
+    NVIC_EnableIRQ(EXTI1_IRQn);
+    NVIC_EnableIRQ(EXTI9_5_IRQn);
 }
 
 
-static
-void wait_for_condition(uint16_t condition) {
-    volatile uint32_t counter = 0;
+/* Controllers numbered as in i2c_device_t and their clock enable bits */
+static I2C_TypeDef *const I2C_CONTROLLERS[I2C_BUSES_NUMBER] = {I2C1, I2C2, I2C3};
 
-    while (!(I2C1->SR1 & condition)) {
-        ++counter;
+static const uint32_t I2C_CLOCKS[I2C_BUSES_NUMBER] = {
+        RCC_APB1ENR_I2C1EN,
+        RCC_APB1ENR_I2C2EN,
+        RCC_APB1ENR_I2C3EN
+};
 
-        if (counter > WAIT_MAX) {
-            I2C1->CR1 |= I2C_CR1_STOP;
+
+/* Sleeps between checks of the flag, SysTick wakes the core every
+ * millisecond
+ */
+static
+void wait_for_condition(I2C_TypeDef *i2c, uint16_t condition) {
+    uint32_t start = timers_ticks();
+
+    while (!(i2c->SR1 & condition)) {
+        if (timers_ticks() - start > WAIT_MAX_MS) {
+            i2c->CR1 |= I2C_CR1_STOP;
             return;
         }
+
+        __WFI();
     }
 }
 
 
 static
-void I2C_configure_partial(uint8_t slave_register_number, uint8_t value) {
-    I2C1->CR1 |= I2C_CR1_START;
-    wait_for_condition(I2C_SR1_SB);
+void I2C_configure_partial(const i2c_device_t *device, uint8_t slave_register_number, uint8_t value) {
+    I2C_TypeDef *i2c = I2C_CONTROLLERS[device->bus - 1];
 
-    I2C1->DR = LIS35DE_ADDR << 1;
+    i2c->CR1 |= I2C_CR1_START;
+    wait_for_condition(i2c, I2C_SR1_SB);
 
-    wait_for_condition(I2C_SR1_ADDR);
+    i2c->DR = device->address << 1;
 
-    I2C1->SR2;
-    I2C1->DR = slave_register_number;
+    wait_for_condition(i2c, I2C_SR1_ADDR);
 
-    wait_for_condition(I2C_SR1_TXE);
+    i2c->SR2;
+    i2c->DR = slave_register_number;
 
-    I2C1->DR = value;
+    wait_for_condition(i2c, I2C_SR1_TXE);
 
-    wait_for_condition(I2C_SR1_BTF);
+    i2c->DR = value;
 
-    I2C1->CR1 |= I2C_CR1_STOP;
-}
+    wait_for_condition(i2c, I2C_SR1_BTF);
 
+    i2c->CR1 |= I2C_CR1_STOP;
+}
 
-void I2C_configure() {
-    GPIOafConfigure(GPIOB,
-                    8,
-                    GPIO_OType_OD,
-                    GPIO_Low_Speed,
-                    GPIO_PuPd_NOPULL,
-                    GPIO_AF_I2C1);
-
-    GPIOafConfigure(GPIOB,
-                    9,
-                    GPIO_OType_OD,
-                    GPIO_Low_Speed,
-                    GPIO_PuPd_NOPULL,
-                    GPIO_AF_I2C1);
 
-    I2C1->CR1 = 0;
-    I2C1->CR2 = PCLK1_MHZ;
+void I2C_configure(uint8_t bus) {
+    I2C_TypeDef *i2c = I2C_CONTROLLERS[bus - 1];
 
-    I2C1->CCR = (PCLK1_MHZ * 1000000) /
-                (I2C_SPEED_HZ << 1);
+    RCC->APB1ENR |= I2C_CLOCKS[bus - 1];
 
-    I2C1->TRISE = PCLK1_MHZ + 1;
+    i2c->CR1 = 0;
+    i2c->CR2 = PCLK_HZ / 1000000;
+    i2c->CCR = SENSOR_BUS_ccr();
+    i2c->TRISE = SENSOR_BUS_trise();
 
-    I2C1->CR1 |= I2C_CR1_PE;
+    i2c->CR1 |= I2C_CR1_PE;
 
     __NOP();
+}
 
-    I2C_configure_partial(I2C_CTRL_REG1, CTRL_REG1_VALUE);
 
-    Delay(100000);
+void LIS35DE_configure(const i2c_device_t *device) {
+    I2C_configure_partial(device, I2C_CTRL_REG1, CTRL_REG1_VALUE);
 
-    I2C_configure_partial(I2C_CTRL_REG3, CTRL_REG3_VALUE);
+    sleep_ms(REGISTER_WRITE_DELAY_MS);
+
+    I2C_configure_partial(device, I2C_CTRL_REG3, CTRL_REG3_VALUE);
 }
 
 
 void TIM_configure() {
-    TIM3->CR1 = 0;
-    TIM3->PSC = 400;
-    TIM3->ARR = 1000;
+    TIM3->CR1 = TIM_CR1_URS;
+    TIM3->PSC = PSC_VALUE;
+    TIM3->ARR = ARR_VALUE;
 
     TIM3->EGR = TIM_EGR_UG;
 
-    TIM3->SR = ~(TIM_SR_UIF | TIM_SR_CC1IF);
-    TIM3->DIER = TIM_DIER_UIE | TIM_DIER_CC1IE;
-
-    TIM3->CCR1 = 500;
+    TIM3->SR = ~TIM_SR_UIF;
+    TIM3->DIER = TIM_DIER_UIE;
 
     TIM3->CR1 |= TIM_CR1_CEN;
 }
 
 
+RAMFUNC
+void TIM_set_period(uint32_t prescaler, uint32_t reload) {
+    TIM3->PSC = prescaler;
+    TIM3->ARR = reload;
+
+    /* Loads the prescaler and restarts the counter, URS keeps this from
+     * raising an update interrupt
+     */
+    TIM3->EGR = TIM_EGR_UG;
+}
+
+
+void DWT_configure() {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+
 void RCC_configure() {
     RCC->AHB1ENR |= RCC_AHB1ENR_GPIOAEN |
                     RCC_AHB1ENR_GPIOBEN |
                     RCC_AHB1ENR_GPIOCEN |
-                    RCC_AHB1ENR_DMA1EN;
+                    RCC_AHB1ENR_DMA1EN |
+                    RCC_AHB1ENR_DMA2EN;
 
     RCC->APB1ENR |= RCC_APB1ENR_USART2EN |
-                    RCC_APB1ENR_I2C1EN |
                     RCC_APB1ENR_TIM3EN;
 
-    RCC->APB2ENR |= RCC_APB2ENR_SYSCFGEN;
+    RCC->APB2ENR |= RCC_APB2ENR_SYSCFGEN |
+                    RCC_APB2ENR_USART1EN |
+                    RCC_APB2ENR_USART6EN;
+}
+
+
+void FLASH_configure() {
+#ifdef USE_FLASH_ACCELERATOR
+    /* The caches may only be reset while disabled */
+    FLASH->ACR &= ~(FLASH_ACR_ICEN | FLASH_ACR_DCEN);
+    FLASH->ACR |= FLASH_ACR_ICRST | FLASH_ACR_DCRST;
+    FLASH->ACR &= ~(FLASH_ACR_ICRST | FLASH_ACR_DCRST);
+
+    FLASH->ACR |= FLASH_ACR_PRFTEN | FLASH_ACR_ICEN | FLASH_ACR_DCEN;
+#endif
+}
+
+
+void LED_configure() {
+    HEARTBEAT_LED_GPIO->BSRR = 1 << (HEARTBEAT_LED_PIN + 16);
 }
 
 
@@ -2,6 +2,28 @@
 #define CONFIGURATION_H
 
 
+/* TIM3 prescaler and auto-reload values: about 40 Hz for the normal
+ * sampling, 400 Hz, the accelerometer output data rate, for capture and
+ * 4 Hz while the device is still in the adaptive mode
+ */
+#define     PSC_VALUE                400
+#define     ARR_VALUE               1000
+#define     CAPTURE_PSC_VALUE         39
+#define     CAPTURE_ARR_VALUE        999
+#define     IDLE_PSC_VALUE          3999
+#define     IDLE_ARR_VALUE           999
+
+
+/* LIS35DE CTRL_REG1 after reset: 400 Hz output data rate, active mode,
+ * all axes enabled
+ */
+#define     CTRL_REG1_VALUE   0b11000111
+
+
+/* LIS35DE CTRL_REG3: INT1 signals FF_WU_1 or FF_WU_2, INT2 signals click */
+#define     CTRL_REG3_VALUE   0b00111011
+
+
 void USART_configure(void);
 
 
@@ -11,15 +33,45 @@ void DMA_configure(void);
 void NVIC_configure(void);
 
 
-void I2C_configure(void);
+/* Clocks and enables the I2C controller, numbered as in i2c_device_t,
+ * at 100 kHz
+ */
+void I2C_configure(uint8_t);
+
+
+struct i2c_device;
+
+/* Powers the LIS35DE up with CTRL_REG1_VALUE and CTRL_REG3_VALUE,
+ * polling its controller; for use before transactions are queued
+ */
+void LIS35DE_configure(const struct i2c_device *);
 
 
 void TIM_configure(void);
 
 
+/* Sets the TIM3 prescaler and auto-reload values, the new period starts
+ * right away
+ */
+void TIM_set_period(uint32_t, uint32_t);
+
+
+void DWT_configure(void);
+
+
 void RCC_configure(void);
 
 
+/* Enables the flash prefetch buffer and instruction and data caches,
+ * unless built with ART=0
+ */
+void FLASH_configure(void);
+
+
+/* Turns the LED off before PINS_configure() makes its pin an output */
+void LED_configure(void);
+
+
 void USART_enable();
 
 
@@ -4,16 +4,57 @@
 
 /* Numbers of LIS35DE control registers       */
 #define     I2C_CTRL_REG1          0x20
+#define     I2C_CTRL_REG2          0x21
 #define     I2C_CTRL_REG3          0x22
 
 
+/* Output data rate bit of CTRL_REG1: 400 Hz when set, 100 Hz when clear */
+#define     CTRL_REG1_DR           0x80
+
+
+/* Numbers of LIS35DE free-fall/wake-up and click engine registers */
+#define     FF_WU_CFG_1            0x30
+#define     FF_WU_SRC_1            0x31
+#define     FF_WU_THS_1            0x32
+#define     FF_WU_DURATION_1       0x33
+#define     FF_WU_CFG_2            0x34
+#define     FF_WU_SRC_2            0x35
+#define     FF_WU_THS_2            0x36
+#define     FF_WU_DURATION_2       0x37
+#define     CLICK_CFG              0x38
+#define     CLICK_SRC              0x39
+#define     CLICK_THSY_X           0x3B
+#define     CLICK_THSZ             0x3C
+#define     CLICK_TIME_LIMIT       0x3D
+#define     CLICK_LATENCY          0x3E
+#define     CLICK_WINDOW           0x3F
+
+
+/* Pins of port A the LIS35DE interrupt outputs are wired to */
+#define     LIS35DE_INT1_PIN       1
+#define     LIS35DE_INT2_PIN       8
+
+
+/* On-board LED blinking while the program runs */
+#define     HEARTBEAT_LED_GPIO     GPIOA
+#define     HEARTBEAT_LED_PIN      5
+
+
 /* Address of accelerometer                   */
 #define     LIS35DE_ADDR           0x1C
 
+/* Address of a LIS35DE with its SDO pin pulled high */
+#define     LIS35DE_ADDR_SDO_HIGH  0x1D
+
 
 /* Numbers of registers corresponding to axes */
 #define     REGISTER_X             0x29
 #define     REGISTER_Y             0x2B
+#define     REGISTER_Z             0x2D
+
+
+/* Sub-address bit enabling register auto-increment in multi-byte reads */
+#define     I2C_AUTO_INCREMENT     0x80
 
 
 #endif /* CONSTS_H */
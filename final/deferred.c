@@ -0,0 +1,52 @@
+#include <stm32.h>
+#include "deferred.h"
+#include "ramfunc.h"
+
+
+static volatile uint32_t pending_work;
+
+
+static deferred_handler_t handlers[DEFERRED_WORK_NUMBER];
+
+
+void deferred_register(deferred_work_t work, deferred_handler_t handler) {
+    handlers[work] = handler;
+}
+
+
+RAMFUNC
+void deferred_post(deferred_work_t work) {
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    pending_work |= 1U << work;
+    __set_PRIMASK(primask);
+
+    SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+}
+
+
+static
+uint32_t take_pending_work(void) {
+    uint32_t work;
+
+    __disable_irq();
+    work = pending_work;
+    pending_work = 0;
+    __enable_irq();
+
+    return work;
+}
+
+
+void PendSV_Handler(void) {
+    uint32_t work;
+
+    while ((work = take_pending_work()) != 0) {
+        for (uint32_t i = 0; i < DEFERRED_WORK_NUMBER; ++i) {
+            if ((work & (1U << i)) && handlers[i] != 0) {
+                handlers[i]();
+            }
+        }
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef DEFERRED_H
+#define DEFERRED_H
+
+
+/* Items of work posted by interrupt handlers and run later from the
+ * PendSV handler; pending items run in the order of this enum and an
+ * item posted several times before it runs is run once
+ */
+typedef enum {
+    WORK_TIMERS,
+    WORK_I2C,
+    WORK_COMMAND,
+    WORK_SAMPLE,
+    WORK_EVENTS,
+    WORK_DMA_COMPLETE,
+    WORK_TRANSPORT,
+    WORK_SINKS,
+    DEFERRED_WORK_NUMBER
+} deferred_work_t;
+
+
+typedef void (*deferred_handler_t)(void);
+
+
+void deferred_register(deferred_work_t, deferred_handler_t);
+
+
+/* Marks the work as pending, callable from any interrupt priority */
+void deferred_post(deferred_work_t);
+
+
+#endif /* DEFERRED_H */
@@ -0,0 +1,185 @@
+#include <stm32.h>
+#include "board.h"
+#include "consts.h"
+#include "deferred.h"
+#include "events.h"
+#include "i2c.h"
+
+
+/* Bits of the source registers */
+#define     SOURCE_IA              0x40
+#define     CLICK_SRC_SINGLE_X     0x01
+#define     CLICK_SRC_DOUBLE_X     0x02
+
+
+typedef enum {
+    EVENT_FREE_FALL,
+    EVENT_WAKE_UP,
+    EVENT_CLICK
+} event_kind_t;
+
+
+/* Events waiting for the deferred work, each as the kind and the value of
+ * its source register
+ */
+static struct {
+    uint8_t kind;
+    uint8_t source;
+} events[EVENTS_QUEUE_SIZE];
+
+static volatile uint32_t events_read_position;
+static volatile uint32_t events_write_position;
+
+
+static char message[EVENTS_MESSAGE_SIZE];
+
+
+static void (*wake_up_handler)(void);
+
+
+/* Accelerometer whose interrupt pins are wired to INT1 and INT2 */
+static const i2c_device_t *events_device;
+
+
+static
+void push_event(event_kind_t kind, uint8_t source) {
+    if (!(source & SOURCE_IA) ||
+        events_write_position - events_read_position == EVENTS_QUEUE_SIZE) {
+        return;
+    }
+
+    events[events_write_position % EVENTS_QUEUE_SIZE].kind = kind;
+    events[events_write_position % EVENTS_QUEUE_SIZE].source = source;
+    events_write_position++;
+
+    deferred_post(WORK_EVENTS);
+}
+
+
+static
+void complete_read_ff_wu_1(void *context, const uint8_t *values, uint32_t length) {
+    push_event(EVENT_FREE_FALL, values[0]);
+}
+
+
+static
+void complete_read_ff_wu_2(void *context, const uint8_t *values, uint32_t length) {
+    if ((values[0] & SOURCE_IA) && wake_up_handler != 0) {
+        wake_up_handler();
+    }
+
+    push_event(EVENT_WAKE_UP, values[0]);
+}
+
+
+static
+void complete_read_click(void *context, const uint8_t *values, uint32_t length) {
+    push_event(EVENT_CLICK, values[0]);
+}
+
+
+static
+char *write_text(char *text, const char *source) {
+    while (*source != '\0') {
+        *text++ = *source++;
+    }
+
+    return text;
+}
+
+
+/* Writes "CLICK <axes>" or, when any axis saw a double click,
+ * "DCLICK <axes>" for the axes with double clicks
+ */
+static
+char *write_click(char *text, uint8_t source) {
+    uint8_t double_click = source & (CLICK_SRC_DOUBLE_X | CLICK_SRC_DOUBLE_X << 2 | CLICK_SRC_DOUBLE_X << 4);
+    uint8_t axis_bit = double_click ? CLICK_SRC_DOUBLE_X : CLICK_SRC_SINGLE_X;
+
+    text = write_text(text, double_click ? "DCLICK " : "CLICK ");
+
+    for (int axis = 0; axis < 3; ++axis) {
+        if (source & (axis_bit << (2 * axis))) {
+            *text++ = 'X' + axis;
+        }
+    }
+
+    return text;
+}
+
+
+void events_set_wake_up_handler(void (*handler)(void)) {
+    wake_up_handler = handler;
+}
+
+
+const char *events_next_message(void) {
+    if (events_read_position == events_write_position) {
+        return 0;
+    }
+
+    uint8_t kind = events[events_read_position % EVENTS_QUEUE_SIZE].kind;
+    uint8_t source = events[events_read_position % EVENTS_QUEUE_SIZE].source;
+    char *text = message;
+
+    events_read_position++;
+
+    if (kind == EVENT_FREE_FALL) {
+        text = write_text(text, "FREEFALL");
+    } else if (kind == EVENT_WAKE_UP) {
+        text = write_text(text, "WAKEUP");
+    } else {
+        text = write_click(text, source);
+    }
+
+    *text++ = '\r';
+    *text++ = '\n';
+    *text = '\0';
+
+    return message;
+}
+
+
+void events_configure(const i2c_device_t *device) {
+    events_device = device;
+
+    i2c_write(device, FF_WU_CFG_1, FF_WU_CFG_1_VALUE, 0, 0);
+    i2c_write(device, FF_WU_THS_1, FF_WU_THS_1_VALUE, 0, 0);
+    i2c_write(device, FF_WU_DURATION_1, FF_WU_DURATION_1_VALUE, 0, 0);
+    i2c_write(device, FF_WU_CFG_2, FF_WU_CFG_2_VALUE, 0, 0);
+    i2c_write(device, FF_WU_THS_2, FF_WU_THS_2_VALUE, 0, 0);
+    i2c_write(device, FF_WU_DURATION_2, FF_WU_DURATION_2_VALUE, 0, 0);
+    i2c_write(device, I2C_CTRL_REG2, CTRL_REG2_VALUE, 0, 0);
+    i2c_write(device, CLICK_CFG, CLICK_CFG_VALUE, 0, 0);
+    i2c_write(device, CLICK_THSY_X, CLICK_THSY_X_VALUE, 0, 0);
+    i2c_write(device, CLICK_THSZ, CLICK_THSZ_VALUE, 0, 0);
+    i2c_write(device, CLICK_TIME_LIMIT, CLICK_TIME_LIMIT_VALUE, 0, 0);
+    i2c_write(device, CLICK_LATENCY, CLICK_LATENCY_VALUE, 0, 0);
+    i2c_write(device, CLICK_WINDOW, CLICK_WINDOW_VALUE, 0, 0);
+
+    /* Release interrupts latched before the configuration */
+    i2c_read(device, FF_WU_SRC_1, 1, 0, 0);
+    i2c_read(device, FF_WU_SRC_2, 1, 0, 0);
+    i2c_read(device, CLICK_SRC, 1, 0, 0);
+
+    EXTI_configure();
+}
+
+
+void EXTI1_IRQHandler(void) {
+    if (EXTI->PR & (1U << LIS35DE_INT1_PIN)) {
+        EXTI->PR = 1U << LIS35DE_INT1_PIN;
+
+        i2c_read(events_device, FF_WU_SRC_1, 1, complete_read_ff_wu_1, 0);
+        i2c_read(events_device, FF_WU_SRC_2, 1, complete_read_ff_wu_2, 0);
+    }
+}
+
+
+void EXTI9_5_IRQHandler(void) {
+    if (EXTI->PR & (1U << LIS35DE_INT2_PIN)) {
+        EXTI->PR = 1U << LIS35DE_INT2_PIN;
+
+        i2c_read(events_device, CLICK_SRC, 1, complete_read_click, 0);
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+
+/* Gesture events detected by the LIS35DE itself: the free-fall and
+ * wake-up engines drive INT1, the click engine drives INT2. Source
+ * registers are read only after an interrupt, so there is no CPU or
+ * link load while nothing happens.
+ */
+
+
+#define EVENTS_QUEUE_SIZE                          16
+#define EVENTS_MESSAGE_SIZE                        16
+
+
+/* Free-fall on FF_WU_1: all axes below the threshold (AND of low events),
+ * latched until the source register is read
+ */
+#define FF_WU_CFG_1_VALUE                  0b11010101
+#define FF_WU_THS_1_VALUE                          20
+#define FF_WU_DURATION_1_VALUE                     40
+
+
+/* Wake-up on FF_WU_2: any axis above the threshold (OR of high events) on
+ * high-pass filtered data, so gravity alone does not trigger it
+ */
+#define FF_WU_CFG_2_VALUE                  0b01101010
+#define FF_WU_THS_2_VALUE                          16
+#define FF_WU_DURATION_2_VALUE                      2
+#define CTRL_REG2_VALUE                    0b00001000
+
+
+/* Single and double clicks on all axes, latched; the thresholds are in
+ * steps of 0.5 g, 1.5 g for X and Y and 2 g for Z, which rests at 1 g
+ */
+#define CLICK_CFG_VALUE                    0b01111111
+#define CLICK_THSY_X_VALUE                       0x33
+#define CLICK_THSZ_VALUE                         0x04
+#define CLICK_TIME_LIMIT_VALUE                     16
+#define CLICK_LATENCY_VALUE                        64
+#define CLICK_WINDOW_VALUE                        128
+
+
+/* Queues the engine register writes to the accelerometer wired to the
+ * interrupt pins and enables the EXTI lines
+ */
+struct i2c_device;
+
+void events_configure(const struct i2c_device *);
+
+
+/* Sets the function called from the I2C interrupt as soon as the
+ * wake-up engine reports motion, before the event is formatted
+ */
+void events_set_wake_up_handler(void (*)(void));
+
+
+/* Returns the text of the next pending event, such as "CLICK XZ\r\n",
+ * "DCLICK Y\r\n", "FREEFALL\r\n" or "WAKEUP\r\n", or 0 when there is
+ * none; the text stays valid until the next call. For deferred work.
+ */
+const char *events_next_message(void);
+
+
+#endif /* EVENTS_H */
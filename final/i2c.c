@@ -0,0 +1,454 @@
+#include <stm32.h>
+#include "consts.h"
+#include "deferred.h"
+#include "i2c.h"
+#include "profile.h"
+#include "ramfunc.h"
+#include "timers.h"
+
+
+/* Error flags ending a transaction: acknowledge failure, bus error,
+ * arbitration loss and overrun
+ */
+#define     I2C_SR1_ERRORS   (I2C_SR1_AF | I2C_SR1_BERR | I2C_SR1_ARLO | I2C_SR1_OVR)
+
+
+/* Enum representing the states of an accelerometer register operation:
+ * WRITING sends the register number, after which a read continues in
+ * READING and a write in WRITING_VALUE
+ */
+typedef enum {
+    IDLE,
+    WRITING,
+    READING,
+    WRITING_VALUE
+} accelerometer_read_state_t;
+
+
+typedef struct {
+    uint8_t address;
+    uint8_t register_number;
+    uint8_t is_write;
+    uint8_t length;
+    uint8_t value;
+    i2c_completion_t completion;
+    void *context;
+} i2c_transaction_t;
+
+
+/* State of one controller */
+typedef struct {
+    I2C_TypeDef *i2c;
+
+    /* Queue of transactions, the one at read_position is in progress */
+    i2c_transaction_t transactions[I2C_TRANSACTIONS_QUEUE_SIZE];
+    volatile uint32_t read_position;
+    volatile uint32_t write_position;
+
+    /* Integer value representing the number of accelerometer register
+     * sent to the device, with the auto-increment bit for multi-byte reads
+     */
+    uint8_t target_register;
+
+    /* Integer value representing the state of accelerometer register
+     * operation
+     */
+    accelerometer_read_state_t read_state;
+
+    /* Integer value representing the number of step of communication
+     * between the program and accelerometer
+     */
+    uint32_t communication_step;
+
+    /* Number of registers already received and their values */
+    uint32_t read_index;
+    uint8_t read_values[I2C_MAX_READ_LENGTH];
+
+    /* Set when the transfer ended with a repeated START for the next
+     * transaction, and when the next transaction waits for a STOP still
+     * being generated
+     */
+    uint8_t restarting;
+    volatile uint8_t start_pending;
+
+    /* Timer aborting a transaction that did not finish in time and the
+     * numbers of transactions aborted this way and by bus errors
+     */
+    software_timer_t timeout_timer;
+    uint32_t timeouts;
+    uint32_t errors;
+} i2c_bus_t;
+
+
+static i2c_bus_t buses[I2C_BUSES_NUMBER] = {
+        {.i2c = I2C1},
+        {.i2c = I2C2},
+        {.i2c = I2C3}
+};
+
+
+static RAMFUNC
+i2c_transaction_t *current_transaction(i2c_bus_t *bus) {
+    return &bus->transactions[bus->read_position % I2C_TRANSACTIONS_QUEUE_SIZE];
+}
+
+
+static RAMFUNC
+void start_transaction(i2c_bus_t *bus) {
+    i2c_transaction_t *transaction = current_transaction(bus);
+    I2C_TypeDef *i2c = bus->i2c;
+
+    bus->target_register = transaction->length > 1
+                           ? transaction->register_number | I2C_AUTO_INCREMENT
+                           : transaction->register_number;
+    bus->read_index = 0;
+
+    bus->read_state = WRITING;
+    bus->communication_step = 0;
+
+    timer_start(&bus->timeout_timer, I2C_TIMEOUT_MS, 0);
+
+    /* The buffer interrupts are enabled once SB is set: after a repeated
+     * START, BTF and TXE of the previous transfer stay set until the
+     * START is generated and would otherwise be taken for this one
+     */
+    if (bus->restarting) {
+        /* The repeated START is already being generated */
+        bus->restarting = 0;
+        i2c->CR2 |= I2C_CR2_ITEVTEN | I2C_CR2_ITERREN;
+    } else if (i2c->CR1 & I2C_CR1_STOP) {
+        /* CR1 must not be written until the STOP is generated */
+        bus->start_pending = 1;
+        deferred_post(WORK_I2C);
+    } else {
+        i2c->CR2 |= I2C_CR2_ITEVTEN | I2C_CR2_ITERREN;
+        i2c->CR1 |= I2C_CR1_START;
+    }
+}
+
+
+/* Ends the transfer with a repeated START when another transaction is
+ * queued, so that it starts without waiting for the bus to be released,
+ * or with a STOP
+ */
+static RAMFUNC
+void end_transfer(i2c_bus_t *bus) {
+    if (bus->write_position - bus->read_position > 1) {
+        bus->restarting = 1;
+        bus->i2c->CR1 |= I2C_CR1_START;
+    } else {
+        bus->i2c->CR1 |= I2C_CR1_STOP;
+    }
+}
+
+
+/* Ends the current transaction and starts the next queued one. A
+ * transaction the completion submits to the then empty queue is started
+ * by submit(), so only one queued before the completion is started here.
+ */
+static RAMFUNC
+void finish_transaction(i2c_bus_t *bus, uint8_t succeeded) {
+    i2c_transaction_t *transaction = current_transaction(bus);
+    uint8_t next_queued;
+
+    timer_cancel(&bus->timeout_timer);
+
+    bus->read_state = IDLE;
+    bus->communication_step = 0;
+    bus->start_pending = 0;
+    bus->i2c->CR2 &= ~(I2C_CR2_ITBUFEN | I2C_CR2_ITEVTEN | I2C_CR2_ITERREN);
+
+    bus->read_position++;
+    next_queued = bus->read_position != bus->write_position;
+
+    if (succeeded && transaction->completion != 0) {
+        transaction->completion(transaction->context,
+                                bus->read_values,
+                                transaction->is_write ? 0 : bus->read_index);
+    }
+
+    if (next_queued) {
+        start_transaction(bus);
+    }
+}
+
+
+static RAMFUNC
+uint8_t submit(const i2c_device_t *device, uint8_t register_number, uint8_t is_write,
+               uint8_t length, uint8_t value, i2c_completion_t completion, void *context) {
+    i2c_bus_t *bus = &buses[device->bus - 1];
+    uint32_t primask = __get_PRIMASK();
+    uint8_t accepted = 0;
+
+    __disable_irq();
+
+    if (bus->write_position - bus->read_position < I2C_TRANSACTIONS_QUEUE_SIZE) {
+        i2c_transaction_t *transaction =
+                &bus->transactions[bus->write_position % I2C_TRANSACTIONS_QUEUE_SIZE];
+
+        transaction->address = device->address;
+        transaction->register_number = register_number;
+        transaction->is_write = is_write;
+        transaction->length = length;
+        transaction->value = value;
+        transaction->completion = completion;
+        transaction->context = context;
+
+        accepted = 1;
+
+        if (bus->write_position++ == bus->read_position) {
+            start_transaction(bus);
+        }
+    }
+
+    __set_PRIMASK(primask);
+
+    return accepted;
+}
+
+
+RAMFUNC
+uint8_t i2c_read(const i2c_device_t *device, uint8_t register_number, uint32_t length,
+                 i2c_completion_t completion, void *context) {
+    if (length == 0 || length > I2C_MAX_READ_LENGTH) {
+        return 0;
+    }
+
+    return submit(device, register_number, 0, length, 0, completion, context);
+}
+
+
+RAMFUNC
+uint8_t i2c_write(const i2c_device_t *device, uint8_t register_number, uint8_t value,
+                  i2c_completion_t completion, void *context) {
+    return submit(device, register_number, 1, 1, value, completion, context);
+}
+
+
+uint32_t i2c_timeouts(void) {
+    uint32_t timeouts = 0;
+
+    for (int i = 0; i < I2C_BUSES_NUMBER; ++i) {
+        timeouts += buses[i].timeouts;
+    }
+
+    return timeouts;
+}
+
+
+uint32_t i2c_errors(void) {
+    uint32_t errors = 0;
+
+    for (int i = 0; i < I2C_BUSES_NUMBER; ++i) {
+        errors += buses[i].errors;
+    }
+
+    return errors;
+}
+
+
+/* Deferred work starting the transactions that waited for a STOP; the
+ * STOP takes a few SCL periods, the work is posted again until then
+ */
+static
+void start_pending_transactions(void) {
+    for (int i = 0; i < I2C_BUSES_NUMBER; ++i) {
+        i2c_bus_t *bus = &buses[i];
+
+        __disable_irq();
+
+        if (bus->start_pending) {
+            if (bus->i2c->CR1 & I2C_CR1_STOP) {
+                deferred_post(WORK_I2C);
+            } else {
+                bus->start_pending = 0;
+                bus->i2c->CR2 |= I2C_CR2_ITEVTEN | I2C_CR2_ITERREN;
+                bus->i2c->CR1 |= I2C_CR1_START;
+            }
+        }
+
+        __enable_irq();
+    }
+}
+
+
+/* Timer callback dropping a transaction lost on the bus; the transaction
+ * the timer expired for may have finished meanwhile and the next one
+ * restarted the timer, which must then be left alone
+ */
+static
+void abort_transaction(void *argument) {
+    i2c_bus_t *bus = argument;
+
+    __disable_irq();
+
+    if (timer_expiry_is_current(&bus->timeout_timer) && bus->read_state != IDLE) {
+        bus->i2c->CR1 |= I2C_CR1_STOP;
+        bus->restarting = 0;
+        bus->timeouts++;
+
+        finish_transaction(bus, 0);
+    }
+
+    __enable_irq();
+}
+
+
+void i2c_init(void) {
+    for (int i = 0; i < I2C_BUSES_NUMBER; ++i) {
+        buses[i].read_position = 0;
+        buses[i].write_position = 0;
+        buses[i].read_state = IDLE;
+        buses[i].restarting = 0;
+        buses[i].start_pending = 0;
+
+        timer_setup(&buses[i].timeout_timer, abort_transaction, &buses[i]);
+    }
+
+    deferred_register(WORK_I2C, start_pending_transactions);
+}
+
+
+static RAMFUNC
+void handle_event(i2c_bus_t *bus) {
+    uint32_t start = profile_start();
+    i2c_transaction_t *transaction = current_transaction(bus);
+    I2C_TypeDef *i2c = bus->i2c;
+
+    if (bus->read_state == WRITING) {
+        if (bus->communication_step == 0) {
+            /* Other events are left from the transfer before a repeated
+             * START, until the START is generated
+             */
+            if (i2c->SR1 & I2C_SR1_SB) {
+                bus->communication_step = 1;
+                i2c->DR = transaction->address << 1;
+                i2c->CR2 |= I2C_CR2_ITBUFEN;
+            }
+        } else if (bus->communication_step == 1 && (i2c->SR1 & I2C_SR1_ADDR)) {
+            bus->communication_step = 2;
+            i2c->SR2;
+
+            i2c->DR = bus->target_register;
+            __NOP();
+            bus->read_state = transaction->is_write ? WRITING_VALUE : READING;
+        } else {
+            i2c->CR1 |= I2C_CR1_STOP;
+        }
+    } else if (bus->read_state == WRITING_VALUE) {
+        if (bus->communication_step == 2 && (i2c->SR1 & I2C_SR1_TXE)) {
+            i2c->DR = transaction->value;
+
+            /* Wait for BTF only, TXE would keep interrupting */
+            i2c->CR2 &= ~I2C_CR2_ITBUFEN;
+            bus->communication_step = 3;
+        } else if (bus->communication_step == 3 && (i2c->SR1 & I2C_SR1_BTF)) {
+            end_transfer(bus);
+            finish_transaction(bus, 1);
+        }
+    } else if (bus->read_state == READING) {
+        if (bus->communication_step == 2 && (i2c->SR1 & I2C_SR1_BTF)) {
+            i2c->CR1 |= I2C_CR1_START;
+            bus->communication_step = 3;
+        } else if (bus->communication_step == 3 && (i2c->SR1 & I2C_SR1_SB)) {
+            i2c->DR = (transaction->address << 1) | 1U;
+
+            if (transaction->length == 1) {
+                i2c->CR1 &= ~I2C_CR1_ACK;
+            } else {
+                i2c->CR1 |= I2C_CR1_ACK;
+            }
+
+            bus->communication_step = 4;
+        }
+        if (bus->communication_step == 4 && (i2c->SR1 & I2C_SR1_ADDR)) {
+            i2c->SR2;
+
+            if (transaction->length == 1) {
+                end_transfer(bus);
+            }
+
+            bus->communication_step = 5;
+        }
+        if (bus->communication_step == 5 && (i2c->SR1 & I2C_SR1_RXNE)) {
+            bus->read_values[bus->read_index++] = i2c->DR;
+
+            /* NACK and stop or restart after the byte being received now */
+            if (transaction->length - bus->read_index == 1) {
+                i2c->CR1 &= ~I2C_CR1_ACK;
+                end_transfer(bus);
+            }
+
+            if (bus->read_index == transaction->length) {
+                __NOP();
+                finish_transaction(bus, 1);
+            }
+        }
+    } else {
+        bus->communication_step = 0;
+        i2c->CR1 |= I2C_CR1_STOP;
+        i2c->CR2 &= ~(I2C_CR2_ITBUFEN | I2C_CR2_ITEVTEN | I2C_CR2_ITERREN);
+    }
+
+    profile_end(PROFILE_I2C, start);
+}
+
+
+/* Ends the transaction at a NACK, a bus error or an arbitration loss,
+ * after which the controller has already left the bus, instead of
+ * leaving it to the timeout
+ */
+static
+void handle_error(i2c_bus_t *bus) {
+    I2C_TypeDef *i2c = bus->i2c;
+    uint32_t errors = i2c->SR1 & I2C_SR1_ERRORS;
+
+    /* The error flags are cleared by writing 0 */
+    i2c->SR1 = ~errors & 0xFFFF;
+
+    if (errors == 0 || bus->read_state == IDLE) {
+        return;
+    }
+
+    if (!(errors & I2C_SR1_ARLO)) {
+        i2c->CR1 |= I2C_CR1_STOP;
+    }
+
+    bus->restarting = 0;
+    bus->errors++;
+
+    finish_transaction(bus, 0);
+}
+
+
+RAMFUNC
+void I2C1_EV_IRQHandler() {
+    handle_event(&buses[0]);
+}
+
+
+RAMFUNC
+void I2C2_EV_IRQHandler() {
+    handle_event(&buses[1]);
+}
+
+
+RAMFUNC
+void I2C3_EV_IRQHandler() {
+    handle_event(&buses[2]);
+}
+
+
+void I2C1_ER_IRQHandler() {
+    handle_error(&buses[0]);
+}
+
+
+void I2C2_ER_IRQHandler() {
+    handle_error(&buses[1]);
+}
+
+
+void I2C3_ER_IRQHandler() {
+    handle_error(&buses[2]);
+}
@@ -0,0 +1,59 @@
+#ifndef I2C_H
+#define I2C_H
+
+
+/* Interrupt-driven transactions with the accelerometers on I2C1, I2C2 and
+ * I2C3. Each controller has its own queue, run one transaction after
+ * another, so the sampler, the event handlers and the command channel may
+ * all issue requests at any time, and transactions on different
+ * controllers proceed at the same time.
+ */
+
+
+#define I2C_BUSES_NUMBER                            3
+#define I2C_TRANSACTIONS_QUEUE_SIZE                16
+#define I2C_MAX_READ_LENGTH                         8
+#define I2C_TIMEOUT_MS                              5
+
+
+/* Slave on one of the controllers, numbered from 1 as I2C1 to I2C3 */
+typedef struct i2c_device {
+    uint8_t bus;
+    uint8_t address;
+} i2c_device_t;
+
+
+/* Called from the I2C interrupt with the context given with the request
+ * and the values read, or with no values after a write
+ */
+typedef void (*i2c_completion_t)(void *, const uint8_t *, uint32_t);
+
+
+/* Queues a read of consecutive registers; returns 0 when the queue of
+ * the controller is full
+ */
+uint8_t i2c_read(const i2c_device_t *, uint8_t, uint32_t, i2c_completion_t, void *);
+
+
+/* Queues a write of one register; returns 0 when the queue of the
+ * controller is full
+ */
+uint8_t i2c_write(const i2c_device_t *, uint8_t, uint8_t, i2c_completion_t, void *);
+
+
+/* Number of transactions aborted because they did not finish in time, on
+ * all controllers
+ */
+uint32_t i2c_timeouts(void);
+
+
+/* Number of transactions ended by a NACK, a bus error, an arbitration
+ * loss or an overrun, on all controllers
+ */
+uint32_t i2c_errors(void);
+
+
+void i2c_init(void);
+
+
+#endif /* I2C_H */
@@ -0,0 +1,52 @@
+#include <stm32.h>
+#include "mailbox.h"
+
+
+void clear_mailbox(mailbox_t *mailbox) {
+    mailbox->sequence = 0;
+    mailbox->message[0] = '\0';
+}
+
+
+void mailbox_publish(mailbox_t *mailbox, const char *message) {
+    uint32_t i = 0;
+
+    mailbox->sequence++;
+    __DMB();
+
+    for (; i < MAILBOX_MESSAGE_SIZE - 1 && message[i] != '\0'; ++i) {
+        mailbox->message[i] = message[i];
+    }
+
+    mailbox->message[i] = '\0';
+
+    __DMB();
+    mailbox->sequence++;
+}
+
+
+uint8_t mailbox_fetch(mailbox_t *mailbox, char *message, uint32_t *last_sequence) {
+    for (;;) {
+        uint32_t sequence = mailbox->sequence;
+
+        /* A reader running in the middle of an update has preempted the
+         * writer, so waiting for it would never end
+         */
+        if ((sequence & 1U) || sequence == *last_sequence) {
+            return 0;
+        }
+
+        __DMB();
+
+        for (uint32_t i = 0; i < MAILBOX_MESSAGE_SIZE; ++i) {
+            message[i] = mailbox->message[i];
+        }
+
+        __DMB();
+
+        if (mailbox->sequence == sequence) {
+            *last_sequence = sequence;
+            return 1;
+        }
+    }
+}
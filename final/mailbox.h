@@ -0,0 +1,34 @@
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+
+/* Room for a sample tagged with its sensor, as in the messages queue */
+#define MAILBOX_MESSAGE_SIZE                       18
+
+
+/* Single-slot mailbox holding the latest message, protected by a sequence
+ * counter: the counter is odd while the writer updates the message, so a
+ * reader can detect a torn copy without disabling interrupts
+ */
+typedef struct {
+    volatile uint32_t sequence;
+    char message[MAILBOX_MESSAGE_SIZE];
+} mailbox_t;
+
+
+void clear_mailbox(mailbox_t *);
+
+
+/* Overwrites the message held by the mailbox */
+void mailbox_publish(mailbox_t *, const char *);
+
+
+/* Copies the message if it is newer than the one identified by the
+ * sequence number pointed to by the last argument and updates that number;
+ * returns 0 when there is nothing new or the writer is in the middle of
+ * an update that has preempted the reader
+ */
+uint8_t mailbox_fetch(mailbox_t *, char *, uint32_t *);
+
+
+#endif /* MAILBOX_H */
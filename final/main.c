@@ -1,204 +1,1128 @@
-#include <gpio.h>
 #include <stm32.h>
-#include <string.h>
+#include "board.h"
 #include "configuration.h"
+#include "capture.h"
+#include "command_parser.h"
 #include "consts.h"
+#include "deferred.h"
+#include "events.h"
+#include "i2c.h"
+#include "mailbox.h"
 #include "messages_queue.h"
+#include "motion.h"
+#include "profile.h"
+#include "ramfunc.h"
+#include "sample_text.h"
+#include "sinks.h"
+#include "stream.h"
+#include "summary.h"
+#include "timers.h"
 
 
-#define     BUFFER_SIZE                          11
-#define     BUFFER_POSITION_X                     0
-#define     BUFFER_POSITION_Y                     4
-#define     BUFFER_POSITION_CR                    8
-#define     BUFFER_POSITION_LF                    9
-#define     REGISTER_VALUE_DECIMAL_LENGTH         3
+#define     SAMPLE_TEXT_SIZE     MESSAGES_QUEUE_MESSAGE_SIZE
+#define     DMA_BUFFER_SIZE      MESSAGES_QUEUE_STATS_TEXT_SIZE
+#define     RX_BUFFER_SIZE                       64
 
 
-/* Enum representing the states of accelerometer register
- * value read operation
+/* Range of sampling periods accepted by the PERIOD command, the shortest
+ * one is the period of the fastest accelerometer output data rate
+ */
+#define     SAMPLING_PERIOD_MIN_US             2500
+#define     SAMPLING_PERIOD_MAX_US           655350
+#define     TIMER_TICKS_PER_US                   16
+#define     TIMER_COUNTER_LIMIT               65536
+
+
+/* Replies to the text commands */
+#define     REPLY_OK                       "OK\r\n"
+#define     REPLY_ERROR                   "ERR\r\n"
+
+
+/* Periods of the software timers, in milliseconds */
+#define     STATS_PERIOD_MS                    1000
+#define     HEARTBEAT_PERIOD_MS                 500
+
+
+/* Sinks fed with samples besides USART2: a logger taking every sample in
+ * hexadecimal on USART1 and a live view taking every fourth X/Y sample in
+ * decimal on USART6
+ */
+#define     LOGGER_BAUD_RATE                 115200
+#define     LIVE_BAUD_RATE                     9600
+#define     LIVE_DECIMATION                       4
+
+
+/* Range of the summary window set by the SUMMARY command, 0 turns the
+ * summary mode off
+ */
+#define     SUMMARY_WINDOW_MIN_MS               100
+#define     SUMMARY_WINDOW_MAX_MS             60000
+
+
+/* Queue overflow policy and transport mode used after reset */
+#define     DEFAULT_QUEUE_POLICY   QUEUE_POLICY_DROP_NEWEST
+#define     DEFAULT_TRANSPORT_MODE      TRANSPORT_QUEUE
+
+
+/* Single-character commands accepted on USART2, each on its own line */
+#define     COMMAND_QUERY_STATS                 'S'
+#define     COMMAND_RESET_STATS                 'R'
+#define     COMMAND_POLICY_DROP_NEWEST          'N'
+#define     COMMAND_POLICY_DROP_OLDEST          'O'
+#define     COMMAND_POLICY_COALESCE             'L'
+#define     COMMAND_TRANSPORT_QUEUE             'Q'
+#define     COMMAND_TRANSPORT_MAILBOX           'M'
+#define     COMMAND_TRANSPORT_STREAM            'D'
+#define     COMMAND_CAPTURE_START               'C'
+#define     COMMAND_CAPTURE_ARM                 'T'
+#define     COMMAND_CAPTURE_END                 'E'
+#define     COMMAND_PERIODIC_STATS              'P'
+#define     COMMAND_ADAPTIVE_SAMPLING           'A'
+
+
+/* Number of bytes of a burst read covering OUT_X, OUT_Y and OUT_Z, which
+ * are interleaved with unused registers
+ */
+#define     ALL_AXES_READ_LENGTH  (REGISTER_Z - REGISTER_X + 1)
+
+
+/* Enum representing the way acceleration samples reach the UART:
+ * TRANSPORT_QUEUE sends every sample through the FIFO queue, while
+ * TRANSPORT_MAILBOX keeps only the latest one, so latency stays bounded
+ * by one sample period plus one frame however far the link falls behind.
+ * TRANSPORT_STREAM packs all output into a byte ring sent gaplessly in
+ * DMA double-buffer mode, for high baud rates.
  */
 typedef enum {
-    IDLE,
-    WRITING,
-    READING
-} accelerometer_read_state_t;
+    TRANSPORT_QUEUE,
+    TRANSPORT_MAILBOX,
+    TRANSPORT_STREAM
+} transport_mode_t;
 
 
-/* Integer value representing the number of accelerometer register from
- * which the value should be received
+/* Settings of the sampler changed by the text commands. Commands edit
+ * the requested set; at the end of each batch it is staged and the
+ * sampling timer switches to it right before starting the next sample,
+ * so no sample is read or formatted with a mix of old and new settings.
  */
-static uint8_t target_register;
+typedef struct {
+    uint32_t prescaler;
+    uint32_t reload;
+    uint8_t ctrl_reg1;
+    uint8_t axes;
+    uint8_t format;
+} sampling_config_t;
 
 
-/* Integer value representing the state of accelerometer register read operation */
-static accelerometer_read_state_t read_state;
+static sampling_config_t active_config;
+static sampling_config_t requested_config;
+static sampling_config_t staged_config;
+static volatile uint8_t config_pending;
 
 
-/* Integer value representing the number of step of communication between
- * the program and accelerometer
+/* Accelerometer sampled by the timer, with its own copy of the last
+ * complete sample for the deferred formatting. Each reads through the
+ * queue of its I2C controller, so sensors on different controllers are
+ * read at the same time. Each sensor has its own summary window; the
+ * primary sensor, the first one, also feeds the motion detector, the
+ * capture and the sinks.
  */
-static uint32_t communication_step;
+typedef struct {
+    i2c_device_t device;
+    uint8_t id;
+    uint8_t axes;
+    uint8_t format;
+    uint8_t sample[SAMPLE_AXES_NUMBER];
+} sensor_t;
+
 
+#define     PRIMARY_SENSOR                        0
 
-/* Integer value for reading acceleration from accelerometer register */
-static uint8_t value_from_register;
 
+static sensor_t sensors[SENSORS_NUMBER];
 
-/* Buffer for sending messages with acceleration values in format
- * Xacc_xYacc_y, where acc_x, acc_y are zero-padded integers
- * corresponding to acceleration on X and Y axes, respectively
+
+/* Context of a queued sample read: the sensor and the axes and format
+ * in force when the read was queued, which a read still waiting behind
+ * others on the bus keeps. Each sensor cycles through as many contexts
+ * as its controller queues transactions, so none is reused while its
+ * read is queued.
  */
-static char buffer[BUFFER_SIZE];
+typedef struct {
+    uint8_t sensor;
+    uint8_t axes;
+    uint8_t format;
+} sample_read_t;
+
+
+static sample_read_t sample_reads[SENSORS_NUMBER][I2C_TRANSACTIONS_QUEUE_SIZE];
+static uint8_t next_sample_read[SENSORS_NUMBER];
+
+
+/* Bit per sensor whose complete sample waits for the deferred work */
+static volatile uint32_t completed_sensors;
+
+
+/* Cycle counter value at the start of the current burst read */
+static uint32_t read_timestamp;
+
+
+/* Rate TIM3 currently runs at: the one set by commands, the low rate
+ * used while the device is still in the adaptive mode, or the capture rate
+ */
+typedef enum {
+    TIMING_NORMAL,
+    TIMING_IDLE,
+    TIMING_CAPTURE
+} sampling_timing_t;
+
+
+static volatile sampling_timing_t sampling_timing;
+
+
+/* Non-zero when the sampling rate follows motion */
+static volatile uint8_t adaptive_sampling;
+
+
+/* Non-zero when USART2 gets one summary record per window instead of
+ * every sample
+ */
+static volatile uint8_t summary_mode;
+
+
+/* Summary window of each sensor, indexed by its id */
+static summary_t summaries[SENSORS_NUMBER];
+
+
+/* Set when motion starts while sampling at the idle rate, so that the
+ * sampling timer takes a sample right away and returns to the normal rate
+ */
+static volatile uint8_t wake_up_requested;
 
 
 /* Static queue for queueing messages */
 static messages_queue_t messages_queue;
 
 
+/* Latest sample of each sensor for the mailbox transport mode */
+static mailbox_t sample_mailboxes[SENSORS_NUMBER];
+
+
+/* Sequence number of the last sample taken from each mailbox */
+static uint32_t sent_sample_sequences[SENSORS_NUMBER];
+
+
+/* Mailbox looked at first by the next transfer, so that every sensor
+ * gets its turn on a busy link
+ */
+static uint32_t next_mailbox;
+
+
+/* Current transport mode of acceleration samples */
+static transport_mode_t transport_mode;
+
+
+/* Buffer the DMA transfers from; messages are copied here so that neither
+ * the sampler nor the queue can overwrite a message in flight
+ */
+static char dma_buffer[DMA_BUFFER_SIZE];
+
+
+/* Buffer for the queue counters reply */
+static char stats_buffer[MESSAGES_QUEUE_STATS_TEXT_SIZE];
+
+
+/* Timers of the periodic queue counters report and of the LED */
+static software_timer_t stats_timer;
+static software_timer_t summary_timer;
+static software_timer_t heartbeat_timer;
+static uint8_t heartbeat_state;
+
+
+/* Sinks on USART1 (DMA2_Stream7) and USART6 (DMA2_Stream6) */
+static sink_t logger_sink = {
+        .usart = USART1,
+        .stream = DMA2_Stream7,
+        .dma_status = &DMA2->HISR,
+        .dma_clear = &DMA2->HIFCR,
+        .complete_flag = DMA_HISR_TCIF7,
+        .axes = COMMAND_AXIS_X | COMMAND_AXIS_Y | COMMAND_AXIS_Z,
+        .format = COMMAND_FORMAT_HEXADECIMAL,
+        .decimation = 1
+};
+
+static sink_t live_sink = {
+        .usart = USART6,
+        .stream = DMA2_Stream6,
+        .dma_status = &DMA2->HISR,
+        .dma_clear = &DMA2->HIFCR,
+        .complete_flag = DMA_HISR_TCIF6,
+        .axes = COMMAND_AXIS_X | COMMAND_AXIS_Y,
+        .format = COMMAND_FORMAT_DECIMAL,
+        .decimation = LIVE_DECIMATION
+};
+
+
+/* Ring the RX DMA writes the received bytes to in circular mode, and
+ * the position of the first byte not parsed yet
+ */
+static char rx_buffer[RX_BUFFER_SIZE];
+static uint32_t rx_read_position;
+static command_parser_t command_parser;
+
+
+static
+void start_DMA(const void *data, uint32_t length) {
+    DMA1_Stream6->CR &= ~DMA_SxCR_DBM;
+    DMA1_Stream6->M0AR = (uint32_t) data;
+    DMA1_Stream6->NDTR = length;
+    DMA1_Stream6->CR |= DMA_SxCR_EN;
+}
+
+
 static
-void initiate_read_from_accelerometer_register(uint8_t register_number) {
-    target_register = register_number;
+void start_receive_DMA(void) {
+    DMA1_Stream5->M0AR = (uint32_t) rx_buffer;
+    DMA1_Stream5->NDTR = RX_BUFFER_SIZE;
+    DMA1_Stream5->CR |= DMA_SxCR_EN;
+}
 
-    read_state = WRITING;
-    communication_step = 0;
 
-    I2C1->CR2 |= I2C_CR2_ITBUFEN | I2C_CR2_ITEVTEN;
-    I2C1->CR1 |= I2C_CR1_START;
+static
+void send_with_DMA(const char *message_text) {
+    uint32_t length = 0;
+
+    while (length < DMA_BUFFER_SIZE && message_text[length] != '\0') {
+        dma_buffer[length] = message_text[length];
+        ++length;
+    }
+
+    start_DMA(dma_buffer, length);
 }
 
 
 static
-void send_with_DMA(char *message_text) {
-    DMA1_Stream6->M0AR = (uint32_t) message_text;
-    DMA1_Stream6->NDTR = strlen(message_text);
-    DMA1_Stream6->CR |= DMA_SxCR_EN;
+uint8_t is_DMA_idle(void) {
+    return (DMA1_Stream6->CR & DMA_SxCR_EN) == 0 &&
+           (DMA1->HISR & DMA_HISR_TCIF6) == 0;
+}
+
+
+static
+uint32_t text_length(const char *text) {
+    uint32_t length = 0;
+
+    while (text[length] != '\0') {
+        ++length;
+    }
+
+    return length;
+}
+
+
+/* Moves captured blocks into the stream ring while they fit */
+static
+void drain_capture_to_stream(void) {
+    const uint8_t *block;
+    uint32_t block_length;
+
+    while (stream_free_space() >= CAPTURE_BLOCK_SIZE &&
+           (block_length = capture_build_block(&block)) > 0) {
+        stream_write(block, block_length);
+    }
+}
+
+
+/* Sends the freshest unsent sample of the first sensor that has one,
+ * looking from the sensor after the last one sent
+ */
+static
+void send_next_mailbox(void) {
+    char sample[MAILBOX_MESSAGE_SIZE];
+
+    for (uint32_t i = 0; i < SENSORS_NUMBER; ++i) {
+        uint32_t sensor = (next_mailbox + i) % SENSORS_NUMBER;
+
+        if (mailbox_fetch(&sample_mailboxes[sensor], sample, &sent_sample_sequences[sensor])) {
+            next_mailbox = (sensor + 1) % SENSORS_NUMBER;
+            send_with_DMA(sample);
+            return;
+        }
+    }
 }
 
 
+/* Starts the next transfer: queued messages go first, then blocks of
+ * captured samples and in the mailbox mode the freshest sample of each
+ * sensor in turn if it has not been sent yet
+ */
 static
-void send(char *message_text) {
-    if ((DMA1_Stream6->CR & DMA_SxCR_EN) == 0 &&
-        (DMA1->HISR & DMA_HISR_TCIF6) == 0) {
+void send_next(void) {
+    const uint8_t *block;
+    uint32_t block_length;
+
+    if (!is_queue_empty(&messages_queue)) {
+        send_with_DMA(poll_queue(&messages_queue));
+    } else if (transport_mode == TRANSPORT_STREAM) {
+        drain_capture_to_stream();
+        stream_start();
+    } else if ((block_length = capture_build_block(&block)) > 0) {
+        start_DMA(block, block_length);
+    } else if (transport_mode == TRANSPORT_MAILBOX) {
+        send_next_mailbox();
+    }
+}
+
+
+static
+void send(const char *message_text) {
+    if (transport_mode == TRANSPORT_STREAM) {
+        stream_write(message_text, text_length(message_text));
+
+        if (is_DMA_idle()) {
+            stream_start();
+        }
+    } else if (is_DMA_idle() && text_length(message_text) <= DMA_BUFFER_SIZE) {
         send_with_DMA(message_text);
-    } else if (!is_queue_full(&messages_queue)) {
-        enqueue(&messages_queue, message_text);
+    } else {
+        offer_text(&messages_queue, message_text);
+
+        if (is_DMA_idle()) {
+            send_next();
+        }
     }
 }
 
 
 static
-void write_value_to_buffer(uint8_t register_number) {
-    int buffer_offset = (register_number == REGISTER_X) ? BUFFER_POSITION_X
-                                                        : BUFFER_POSITION_Y;
+void send_sample(const sensor_t *sensor, const char *sample_text) {
+    if (transport_mode == TRANSPORT_MAILBOX) {
+        mailbox_publish(&sample_mailboxes[sensor->id], sample_text);
 
-    uint8_t value = value_from_register;
+        if (is_DMA_idle()) {
+            send_next();
+        }
+    } else if (transport_mode == TRANSPORT_QUEUE && !is_DMA_idle()) {
+        offer_sample(&messages_queue, sample_text);
+    } else {
+        send(sample_text);
+    }
+}
+
+
+/* Makes the sampling timer leave the idle rate with a sample right away */
+static RAMFUNC
+void request_normal_rate(void) {
+    if (sampling_timing == TIMING_IDLE) {
+        wake_up_requested = 1;
+        NVIC_SetPendingIRQ(TIM3_IRQn);
+    }
+}
+
+
+static
+void handle_character_command(char command) {
+    switch (command) {
+        case COMMAND_QUERY_STATS:
+            format_queue_stats(&messages_queue, stats_buffer);
+            send(stats_buffer);
+            break;
+        case COMMAND_RESET_STATS:
+            reset_queue_stats(&messages_queue);
+            break;
+        case COMMAND_POLICY_DROP_NEWEST:
+            set_queue_policy(&messages_queue, QUEUE_POLICY_DROP_NEWEST);
+            break;
+        case COMMAND_POLICY_DROP_OLDEST:
+            set_queue_policy(&messages_queue, QUEUE_POLICY_DROP_OLDEST);
+            break;
+        case COMMAND_POLICY_COALESCE:
+            set_queue_policy(&messages_queue, QUEUE_POLICY_COALESCE);
+            break;
+        case COMMAND_TRANSPORT_QUEUE:
+            transport_mode = TRANSPORT_QUEUE;
+            break;
+        case COMMAND_TRANSPORT_MAILBOX:
+            /* A backlog of queued samples would go out before the latest
+             * one and delay it by as much as the queue holds
+             */
+            discard_samples(&messages_queue);
+
+            for (int i = 0; i < SENSORS_NUMBER; ++i) {
+                sent_sample_sequences[i] = sample_mailboxes[i].sequence;
+            }
 
-    for (int i = REGISTER_VALUE_DECIMAL_LENGTH; i > 0; --i) {
-        char char_to_buffer = (value % 10) + '0';
-        buffer[buffer_offset + i] = char_to_buffer;
+            transport_mode = TRANSPORT_MAILBOX;
+            break;
+        case COMMAND_TRANSPORT_STREAM:
+            transport_mode = TRANSPORT_STREAM;
+            break;
+        case COMMAND_CAPTURE_START:
+        case COMMAND_CAPTURE_ARM:
+            /* The I2C handler stores samples into the capture ring */
+            __disable_irq();
+            capture_start(command == COMMAND_CAPTURE_ARM);
+            __enable_irq();
+            break;
+        case COMMAND_CAPTURE_END:
+            capture_stop();
+            break;
+        case COMMAND_ADAPTIVE_SAMPLING:
+            adaptive_sampling ^= 1;
+
+            if (!adaptive_sampling) {
+                request_normal_rate();
+            }
+            break;
+        case COMMAND_PERIODIC_STATS:
+            if (timer_is_active(&stats_timer)) {
+                timer_cancel(&stats_timer);
+            } else {
+                timer_start(&stats_timer, STATS_PERIOD_MS, STATS_PERIOD_MS);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+
+static
+char *write_number(char *text, uint32_t value) {
+    char digits[10];
+    int length = 0;
+
+    do {
+        digits[length++] = value % 10 + '0';
         value /= 10;
+    } while (value > 0);
+
+    while (length > 0) {
+        *text++ = digits[--length];
     }
+
+    return text;
 }
 
 
-void DMA1_Stream6_IRQHandler(void) {
-    uint32_t isr = DMA1->HISR;
+/* Sends "KI<I2C timeouts>E<I2C errors>S<stream bytes dropped>C<capture
+ * overflows>\r\n" after the queue counters
+ */
+static
+void send_counters(void) {
+    char *text = stats_buffer;
 
-    if (isr & DMA_HISR_TCIF6) {
-        DMA1->HIFCR = DMA_HIFCR_CTCIF6;
+    handle_character_command(COMMAND_QUERY_STATS);
+
+    *text++ = 'K';
+    *text++ = 'I';
+    text = write_number(text, i2c_timeouts());
+    *text++ = 'E';
+    text = write_number(text, i2c_errors());
+    *text++ = 'S';
+    text = write_number(text, stream_dropped_bytes());
+    *text++ = 'C';
+    text = write_number(text, capture_overflows());
+    *text++ = '\r';
+    *text++ = '\n';
+    *text = '\0';
+
+    send(stats_buffer);
+}
+
+
+/* Writes the summary of the window of the sensor, tagged "D<id>" when
+ * several sensors are sampled
+ */
+static
+uint32_t format_sensor_summary(char *text, uint8_t sensor, const summary_t *window) {
+    uint32_t length = 0;
+
+#if SENSORS_NUMBER > 1
+    length = format_sensor_tag(text, sensor);
+#endif
+
+    return length + format_summary(text + length, window, active_config.axes);
+}
+
+
+/* Sends the statistics of the window that just ended of each sensor,
+ * nothing for a sensor no sample was read from in it
+ */
+static
+void send_summary(void *argument) {
+    summary_t window;
+    char text[SENSOR_TAG_LENGTH + SUMMARY_TEXT_MAX_LENGTH + 1];
+
+    for (int i = 0; i < SENSORS_NUMBER; ++i) {
+        __disable_irq();
+        summary_take(&summaries[i], &window);
+        __enable_irq();
+
+        if (window.samples > 0) {
+            text[format_sensor_summary(text, i, &window)] = '\0';
+            send(text);
+        }
+    }
+}
+
+
+/* Starts summary windows of the given length, or goes back to sending
+ * every sample when it is 0
+ */
+static
+void set_summary_window(uint32_t window_ms) {
+    __disable_irq();
+
+    for (int i = 0; i < SENSORS_NUMBER; ++i) {
+        summary_reset(&summaries[i]);
+    }
+
+    summary_mode = window_ms != 0;
+    __enable_irq();
+
+    if (window_ms != 0) {
+        timer_start(&summary_timer, window_ms, window_ms);
+    } else {
+        timer_cancel(&summary_timer);
+    }
+}
+
+
+static
+void send_cycles(void) {
+    char text[PROFILE_TEXT_SIZE];
+
+    format_profile(text);
+    send(text);
+}
+
+
+/* Converts the sampling period to TIM3 settings: 1 us ticks up to the
+ * limit of the 16-bit counter and 10 us ticks above it
+ */
+static
+void set_requested_period(uint32_t period_us) {
+    uint32_t tick_us = period_us <= TIMER_COUNTER_LIMIT ? 1 : 10;
+
+    requested_config.prescaler = TIMER_TICKS_PER_US * tick_us - 1;
+    requested_config.reload = period_us / tick_us - 1;
+}
+
+
+/* Handles a parsed command; returns 1 when it changed the sampling
+ * settings, which are then staged with the rest of the batch
+ */
+static
+uint8_t handle_command(const command_t *command) {
+    uint8_t valid = 1;
+
+    switch (command->kind) {
+        case COMMAND_CHARACTER:
+            handle_character_command((char) command->argument);
+            return 0;
+        case COMMAND_PERIOD:
+            valid = command->argument >= SAMPLING_PERIOD_MIN_US &&
+                    command->argument <= SAMPLING_PERIOD_MAX_US;
+
+            if (valid) {
+                set_requested_period(command->argument);
+            }
+            break;
+        case COMMAND_ODR:
+            valid = command->argument == 100 || command->argument == 400;
+
+            if (valid) {
+                requested_config.ctrl_reg1 = command->argument == 400
+                        ? requested_config.ctrl_reg1 | CTRL_REG1_DR
+                        : requested_config.ctrl_reg1 & ~CTRL_REG1_DR;
+            }
+            break;
+        case COMMAND_AXES:
+            requested_config.axes = command->argument;
+            break;
+        case COMMAND_FORMAT:
+            requested_config.format = command->argument;
+            break;
+        case COMMAND_POLICY:
+            set_queue_policy(&messages_queue, (queue_policy_t) command->argument);
+            send(REPLY_OK);
+            return 0;
+        case COMMAND_COUNTERS:
+            send_counters();
+            return 0;
+        case COMMAND_CYCLES:
+            send_cycles();
+            return 0;
+        case COMMAND_SUMMARY:
+            valid = command->argument == 0 ||
+                    (command->argument >= SUMMARY_WINDOW_MIN_MS &&
+                     command->argument <= SUMMARY_WINDOW_MAX_MS);
+
+            if (valid) {
+                set_summary_window(command->argument);
+            }
+
+            send(valid ? REPLY_OK : REPLY_ERROR);
+            return 0;
+        default:
+            valid = 0;
+            break;
+    }
+
+    send(valid ? REPLY_OK : REPLY_ERROR);
+
+    return valid;
+}
+
+
+/* Hands the requested settings over to the sampling timer */
+static
+void stage_config(void) {
+    __disable_irq();
+    staged_config = requested_config;
+    config_pending = 1;
+    __enable_irq();
+}
+
+
+/* Switches to the staged settings, called by the sampling timer between
+ * samples; the ODR write is queued before the read of the next sample.
+ * Returns 1 when the sampling period has changed.
+ */
+static RAMFUNC
+uint8_t apply_pending_config(void) {
+    if (!config_pending) {
+        return 0;
+    }
+
+    config_pending = 0;
 
-        if (!is_queue_empty(&messages_queue)) {
-            send_with_DMA(poll_queue(&messages_queue));
+    if (staged_config.ctrl_reg1 != active_config.ctrl_reg1) {
+        for (int i = 0; i < SENSORS_NUMBER; ++i) {
+            i2c_write(&sensors[i].device, I2C_CTRL_REG1, staged_config.ctrl_reg1, 0, 0);
         }
     }
+
+    uint8_t period_changed = staged_config.prescaler != active_config.prescaler ||
+                             staged_config.reload != active_config.reload;
+
+    active_config = staged_config;
+
+    return period_changed;
 }
 
 
-void I2C1_EV_IRQHandler() {
-    if (read_state == WRITING) {
-        if (communication_step == 0 && (I2C1->SR1 & I2C_SR1_SB)) {
-            communication_step = 1;
-            I2C1->DR = LIS35DE_ADDR << 1;
-        } else if (communication_step == 1 && (I2C1->SR1 & I2C_SR1_ADDR)) {
-            communication_step = 2;
-            I2C1->SR2;
+/* Called from the I2C interrupt when the wake-up engine reports motion */
+static
+void wake_up_sampler(void) {
+    motion_reset();
+    request_normal_rate();
+}
+
+
+/* Completions of the sampler reads, called from the I2C interrupt of the
+ * controller of the sensor of the sample_read_t given as the context
+ */
+static RAMFUNC
+void complete_read_sample(void *context, const uint8_t *values, uint32_t length) {
+    const sample_read_t *read = context;
+    sensor_t *sensor = &sensors[read->sensor];
+
+    for (int axis = 0; axis < SAMPLE_AXES_NUMBER; ++axis) {
+        sensor->sample[axis] = values[axis * (REGISTER_Y - REGISTER_X)];
+    }
+
+    sensor->axes = read->axes;
+    sensor->format = read->format;
+
+    /* All I2C interrupts share one priority, so none preempts this */
+    completed_sensors |= 1U << sensor->id;
 
-            I2C1->DR = target_register;
-            __NOP();
-            read_state = READING;
-        } else {
-            I2C1->CR1 |= I2C_CR1_STOP;
+    if (sensor->id == PRIMARY_SENSOR) {
+        if (motion_update((int8_t) sensor->sample[0],
+                          (int8_t) sensor->sample[1],
+                          (int8_t) sensor->sample[2])) {
+            request_normal_rate();
         }
-    } else if (read_state == READING) {
-        if (communication_step == 2 && (I2C1->SR1 & I2C_SR1_BTF)) {
-            I2C1->CR1 |= I2C_CR1_START;
-            communication_step = 3;
-        } else if (communication_step == 3 && (I2C1->SR1 & I2C_SR1_SB)) {
-            I2C1->DR = (LIS35DE_ADDR << 1) | 1U;
-            I2C1->CR1 &= ~I2C_CR1_ACK;
-            communication_step = 4;
+
+    }
+
+    if (summary_mode) {
+        summary_update(&summaries[sensor->id],
+                       (int8_t) sensor->sample[0],
+                       (int8_t) sensor->sample[1],
+                       (int8_t) sensor->sample[2]);
+    }
+
+    deferred_post(WORK_SAMPLE);
+}
+
+
+static RAMFUNC
+void complete_read_all_axes(void *context, const uint8_t *values, uint32_t length) {
+    capture_store(read_timestamp,
+                  values[0],
+                  values[REGISTER_Y - REGISTER_X],
+                  values[REGISTER_Z - REGISTER_X]);
+
+    deferred_post(WORK_TRANSPORT);
+}
+
+
+static
+void report_stats(void *argument) {
+    handle_character_command(COMMAND_QUERY_STATS);
+}
+
+
+static
+void toggle_heartbeat(void *argument) {
+    heartbeat_state ^= 1;
+
+    HEARTBEAT_LED_GPIO->BSRR = heartbeat_state ? 1 << HEARTBEAT_LED_PIN
+                                               : 1 << (HEARTBEAT_LED_PIN + 16);
+}
+
+
+/* Writes the sample of the sensor, tagged "D<id>" when several sensors
+ * are sampled
+ */
+static
+uint32_t format_sensor_sample(char *text, const sensor_t *sensor) {
+    uint32_t length = 0;
+
+#if SENSORS_NUMBER > 1
+    length = format_sensor_tag(text, sensor->id);
+#endif
+
+    return length + format_sample(text + length, sensor->sample, sensor->axes, sensor->format);
+}
+
+
+/* Deferred work run for the samples read by the timer */
+static
+void process_sample(void) {
+    char sample_text[SAMPLE_TEXT_SIZE];
+    uint32_t completed;
+
+    __disable_irq();
+    completed = completed_sensors;
+    completed_sensors = 0;
+    __enable_irq();
+
+    for (int i = 0; i < SENSORS_NUMBER; ++i) {
+        if (!(completed & (1U << i))) {
+            continue;
+        }
+
+        if (!summary_mode) {
+            sample_text[format_sensor_sample(sample_text, &sensors[i])] = '\0';
+
+            send_sample(&sensors[i], sample_text);
+        }
+
+        if (i == PRIMARY_SENSOR) {
+            sinks_publish(sensors[i].sample);
         }
-        if (communication_step == 4 && (I2C1->SR1 & I2C_SR1_ADDR)) {
-            I2C1->SR2;
-            I2C1->CR1 |= I2C_CR1_STOP;
-            communication_step = 5;
+    }
+}
+
+
+/* Deferred work sending the messages of accelerometer events */
+static
+void process_events(void) {
+    const char *message;
+
+    while ((message = events_next_message()) != 0) {
+        send(message);
+    }
+}
+
+
+/* Deferred work run after each finished DMA transfer, the stream
+ * buffer is already refilled by the interrupt
+ */
+static
+void process_DMA_complete(void) {
+    if (stream_is_running()) {
+        drain_capture_to_stream();
+        return;
+    }
+
+    /* Work run before this one may have already started a transfer */
+    if (is_DMA_idle()) {
+        send_next();
+    }
+}
+
+
+/* Deferred work run when new data may be waiting for an idle link */
+static
+void process_transport(void) {
+    if (is_DMA_idle()) {
+        send_next();
+    } else if (stream_is_running()) {
+        drain_capture_to_stream();
+    }
+}
+
+
+/* Deferred work parsing the bytes the RX DMA has written since the last
+ * run; settings changed by the whole batch are staged together
+ */
+static
+void process_commands(void) {
+    uint32_t write_position = (RX_BUFFER_SIZE - DMA1_Stream5->NDTR) % RX_BUFFER_SIZE;
+    uint8_t config_changed = 0;
+    command_t command;
+
+    while (rx_read_position != write_position) {
+        if (command_parse_byte(&command_parser, rx_buffer[rx_read_position], &command)) {
+            config_changed |= handle_command(&command);
         }
-        if (communication_step == 5 && (I2C1->SR1 & I2C_SR1_RXNE)) {
-            value_from_register = I2C1->DR;
-            __NOP();
-            read_state = IDLE;
+
+        rx_read_position = (rx_read_position + 1) % RX_BUFFER_SIZE;
+    }
+
+    if (config_changed) {
+        stage_config();
+    }
+}
+
+
+RAMFUNC
+void DMA1_Stream6_IRQHandler(void) {
+    uint32_t start = profile_start();
+    uint32_t isr = DMA1->HISR;
+
+    if (isr & DMA_HISR_TCIF6) {
+        DMA1->HIFCR = DMA_HIFCR_CTCIF6;
+
+        if (stream_is_running()) {
+            stream_buffer_complete();
         }
+
+        deferred_post(WORK_DMA_COMPLETE);
+    }
+
+    profile_end(PROFILE_USART_TX_DMA, start);
+}
+
+
+void DMA2_Stream7_IRQHandler(void) {
+    if (DMA2->HISR & DMA_HISR_TCIF7) {
+        sink_transfer_complete(&logger_sink);
+
+        deferred_post(WORK_SINKS);
+    }
+}
+
+
+void DMA2_Stream6_IRQHandler(void) {
+    if (DMA2->HISR & DMA_HISR_TCIF6) {
+        sink_transfer_complete(&live_sink);
+
+        deferred_post(WORK_SINKS);
+    }
+}
+
+
+/* The RX DMA interrupts at half and at the end of the ring, the idle
+ * line interrupt delivers commands shorter than that
+ */
+void DMA1_Stream5_IRQHandler(void) {
+    uint32_t isr = DMA1->HISR;
+
+    if (isr & (DMA_HISR_HTIF5 | DMA_HISR_TCIF5)) {
+        DMA1->HIFCR = DMA_HIFCR_CHTIF5 | DMA_HIFCR_CTCIF5;
+
+        deferred_post(WORK_COMMAND);
+    }
+}
+
+
+void USART2_IRQHandler(void) {
+    if (USART2->SR & USART_SR_IDLE) {
+        /* Reading SR and then DR clears the flag */
+        USART2->DR;
+
+        deferred_post(WORK_COMMAND);
+    }
+}
+
+
+/* Switches TIM3 to the rate required by the capture state and, in the
+ * adaptive mode, by motion, or reloads the period changed by a command
+ */
+static RAMFUNC
+void update_sampling_rate(uint8_t period_changed) {
+    sampling_timing_t timing = TIMING_NORMAL;
+
+    if (capture_is_sampling()) {
+        timing = TIMING_CAPTURE;
+    } else if (adaptive_sampling && motion_is_still()) {
+        timing = TIMING_IDLE;
+    }
+
+    if (timing == sampling_timing && !(period_changed && timing == TIMING_NORMAL)) {
+        return;
+    }
+
+    sampling_timing = timing;
+
+    if (timing == TIMING_CAPTURE) {
+        TIM_set_period(CAPTURE_PSC_VALUE, CAPTURE_ARR_VALUE);
+    } else if (timing == TIMING_IDLE) {
+        TIM_set_period(IDLE_PSC_VALUE, IDLE_ARR_VALUE);
     } else {
-        communication_step = 0;
-        I2C1->CR1 |= I2C_CR1_STOP;
-        I2C1->CR2 &= ~(I2C_CR2_ITBUFEN | I2C_CR2_ITEVTEN | I2C_CR2_ITERREN);
+        TIM_set_period(active_config.prescaler, active_config.reload);
     }
 }
 
 
+/* Reads all axes of a sample in one burst, settings staged by commands
+ * take effect right before it. A wake-up request samples immediately,
+ * the normal period restarts from there.
+ */
+RAMFUNC
 void TIM3_IRQHandler(void) {
-    uint32_t interrupt_status = TIM3->SR & TIM3->DIER;
+    uint32_t start = profile_start();
+
+    if (!(TIM3->SR & TIM_SR_UIF) && !wake_up_requested) {
+        return;
+    }
+
+    TIM3->SR = ~TIM_SR_UIF;
+    wake_up_requested = 0;
+
+    update_sampling_rate(apply_pending_config());
+
+    if (sampling_timing == TIMING_CAPTURE) {
+        read_timestamp = DWT->CYCCNT;
+        i2c_read(&sensors[PRIMARY_SENSOR].device, REGISTER_X, ALL_AXES_READ_LENGTH,
+                 complete_read_all_axes, 0);
+    } else {
+        for (int i = 0; i < SENSORS_NUMBER; ++i) {
+            sample_read_t *read = &sample_reads[i][next_sample_read[i]];
+
+            read->sensor = i;
+            read->axes = active_config.axes;
+            read->format = active_config.format;
+
+            if (i2c_read(&sensors[i].device, REGISTER_X, ALL_AXES_READ_LENGTH,
+                         complete_read_sample, read)) {
+                next_sample_read[i] = (next_sample_read[i] + 1) % I2C_TRANSACTIONS_QUEUE_SIZE;
+            }
+        }
+    }
+
+    profile_end(PROFILE_SAMPLING_TIMER, start);
+}
 
-    if (interrupt_status & TIM_SR_UIF) {
-        initiate_read_from_accelerometer_register(REGISTER_X);
-        write_value_to_buffer(REGISTER_X);
 
-        TIM3->SR = ~TIM_SR_UIF;
+static
+void init_sensors(void) {
+    static const i2c_device_t devices[] = SENSOR_DEVICES;
+
+    for (int i = 0; i < SENSORS_NUMBER; ++i) {
+        sensors[i].device = devices[i];
+        sensors[i].id = i;
+        next_sample_read[i] = 0;
     }
 
-    if (interrupt_status & TIM_SR_CC1IF) {
-        initiate_read_from_accelerometer_register(REGISTER_Y);
-        write_value_to_buffer(REGISTER_Y);
+    completed_sensors = 0;
+}
 
-        TIM3->SR = ~TIM_SR_CC1IF;
 
-        send(buffer);
+/* Sets up each I2C controller in use once and powers its sensors up */
+static
+void configure_sensors(void) {
+    uint32_t configured_buses = 0;
+
+    for (int i = 0; i < SENSORS_NUMBER; ++i) {
+        uint8_t bus = sensors[i].device.bus;
+
+        if (!(configured_buses & (1U << bus))) {
+            I2C_configure(bus);
+            configured_buses |= 1U << bus;
+        }
+
+        LIS35DE_configure(&sensors[i].device);
     }
 }
 
 
 static
-void init_buffer() {
-    buffer[BUFFER_POSITION_X] = 'X';
-    buffer[BUFFER_POSITION_Y] = 'Y';
-    buffer[BUFFER_POSITION_CR] = '\r';
-    buffer[BUFFER_POSITION_LF] = '\n';
+void init_config() {
+    active_config.prescaler = PSC_VALUE;
+    active_config.reload = ARR_VALUE;
+    active_config.ctrl_reg1 = CTRL_REG1_VALUE;
+    active_config.axes = COMMAND_AXIS_X | COMMAND_AXIS_Y;
+    active_config.format = COMMAND_FORMAT_DECIMAL;
+
+    requested_config = active_config;
+    config_pending = 0;
 }
 
 
 int main(void) {
-    init_buffer();
+    ramfunc_init();
+
+#ifdef RAM_VECTORS
+    vectors_relocate();
+#endif
+
+    init_config();
+    init_sensors();
+    command_parser_reset(&command_parser);
+    motion_reset();
+
+    clear_queue(&messages_queue);
+    set_queue_policy(&messages_queue, DEFAULT_QUEUE_POLICY);
+
+    for (int i = 0; i < SENSORS_NUMBER; ++i) {
+        clear_mailbox(&sample_mailboxes[i]);
+    }
+
+    transport_mode = DEFAULT_TRANSPORT_MODE;
+
+    deferred_register(WORK_COMMAND, process_commands);
+    deferred_register(WORK_SAMPLE, process_sample);
+    deferred_register(WORK_EVENTS, process_events);
+    deferred_register(WORK_DMA_COMPLETE, process_DMA_complete);
+    deferred_register(WORK_TRANSPORT, process_transport);
+    deferred_register(WORK_SINKS, sinks_service);
+
+    timer_setup(&stats_timer, report_stats, 0);
+    timer_setup(&summary_timer, send_summary, 0);
+    timer_setup(&heartbeat_timer, toggle_heartbeat, 0);
 
     RCC_configure();
+    FLASH_configure();
+    LED_configure();
+    PINS_configure();
     USART_configure();
     DMA_configure();
+    sink_register(&logger_sink, LOGGER_brr(LOGGER_BAUD_RATE), LOGGER_dma_channel_bits());
+    sink_register(&live_sink, LIVE_brr(LIVE_BAUD_RATE), LIVE_dma_channel_bits());
+    timers_init();
     NVIC_configure();
-    I2C_configure();
+    configure_sensors();
+    i2c_init();
+    events_configure(&sensors[PRIMARY_SENSOR].device);
+    events_set_wake_up_handler(wake_up_sampler);
     TIM_configure();
+    DWT_configure();
 
+    start_receive_DMA();
     USART_enable();
 
-    for (;;) {}
+    timer_start(&heartbeat_timer, HEARTBEAT_PERIOD_MS, HEARTBEAT_PERIOD_MS);
+
+    for (;;) {
+        __WFI();
+    }
 
     return 0;
 }
@@ -1,5 +1,6 @@
 #include <stm32.h>
 #include "messages_queue.h"
+#include "ramfunc.h"
 
 
 void clear_queue(messages_queue_t *queue) {
@@ -7,32 +8,240 @@ void clear_queue(messages_queue_t *queue) {
     queue->insert_position = 0;
 
     queue->used_space = 0;
+    queue->polling_text = 0;
 }
 
 
+RAMFUNC
 uint8_t is_queue_empty(messages_queue_t *queue) {
     return queue->used_space == 0;
 }
 
 
+RAMFUNC
 uint8_t is_queue_full(messages_queue_t *queue) {
     return queue->used_space == MESSAGES_QUEUE_BUFFER_SIZE;
 }
 
 
-void enqueue(messages_queue_t *queue, char *message) {
-    queue->messages[queue->insert_position] = message;
+static RAMFUNC
+void copy_message(char *slot, const char *message) {
+    uint32_t i = 0;
+
+    for (; i < MESSAGES_QUEUE_MESSAGE_SIZE - 1 && message[i] != '\0'; ++i) {
+        slot[i] = message[i];
+    }
+
+    slot[i] = '\0';
+}
+
+
+RAMFUNC
+void enqueue(messages_queue_t *queue, const char *message) {
+    copy_message(queue->messages[queue->insert_position], message);
+    queue->flags[queue->insert_position] = 0;
 
     queue->insert_position = (queue->insert_position + 1) % MESSAGES_QUEUE_BUFFER_SIZE;
     queue->used_space++;
 }
 
 
+RAMFUNC
 char *poll_queue(messages_queue_t *queue) {
     char *message = queue->messages[queue->read_position];
 
+    queue->polling_text = queue->flags[queue->read_position] & MESSAGES_QUEUE_CONTINUED;
     queue->read_position = (queue->read_position + 1) % MESSAGES_QUEUE_BUFFER_SIZE;
     queue->used_space--;
 
     return message;
 }
+
+
+void set_queue_policy(messages_queue_t *queue, queue_policy_t policy) {
+    queue->policy = policy;
+}
+
+
+static RAMFUNC
+void update_high_water(messages_queue_t *queue) {
+    if (queue->used_space > queue->stats.high_water) {
+        queue->stats.high_water = queue->used_space;
+    }
+}
+
+
+/* Drops the oldest message, with all its parts when it starts a text */
+static RAMFUNC
+void drop_oldest(messages_queue_t *queue) {
+    uint8_t flags;
+
+    do {
+        flags = queue->flags[queue->read_position];
+
+        queue->read_position = (queue->read_position + 1) % MESSAGES_QUEUE_BUFFER_SIZE;
+        queue->used_space--;
+    } while (flags & MESSAGES_QUEUE_CONTINUED);
+
+    queue->stats.dropped++;
+}
+
+
+/* Frees the given number of slots by dropping the oldest messages when
+ * the policy allows it; the rest of a text whose first part has already
+ * been polled is never dropped. Returns 0 when there is no room.
+ */
+static RAMFUNC
+uint8_t make_room(messages_queue_t *queue, uint32_t slots) {
+    while (MESSAGES_QUEUE_BUFFER_SIZE - queue->used_space < slots) {
+        if (queue->policy == QUEUE_POLICY_DROP_NEWEST || queue->polling_text) {
+            return 0;
+        }
+
+        drop_oldest(queue);
+    }
+
+    return 1;
+}
+
+
+static RAMFUNC
+uint8_t offer_flagged(messages_queue_t *queue, const char *message, uint8_t flags) {
+    uint32_t newest = (queue->insert_position + MESSAGES_QUEUE_BUFFER_SIZE - 1) %
+                      MESSAGES_QUEUE_BUFFER_SIZE;
+
+    if (is_queue_full(queue) && queue->policy == QUEUE_POLICY_COALESCE &&
+        (flags & MESSAGES_QUEUE_SAMPLE) && (queue->flags[newest] & MESSAGES_QUEUE_SAMPLE)) {
+        /* Overwrite the newest queued sample in place */
+        copy_message(queue->messages[newest], message);
+        queue->stats.dropped++;
+        queue->stats.enqueued++;
+
+        return 1;
+    }
+
+    if (!make_room(queue, 1)) {
+        queue->stats.dropped++;
+        return 0;
+    }
+
+    uint32_t slot = queue->insert_position;
+
+    enqueue(queue, message);
+    queue->flags[slot] = flags;
+    queue->stats.enqueued++;
+    update_high_water(queue);
+
+    return 1;
+}
+
+
+RAMFUNC
+uint8_t offer(messages_queue_t *queue, const char *message) {
+    return offer_flagged(queue, message, 0);
+}
+
+
+uint8_t offer_text(messages_queue_t *queue, const char *text) {
+    const uint32_t part_length = MESSAGES_QUEUE_MESSAGE_SIZE - 1;
+    uint32_t length = 0;
+
+    while (text[length] != '\0') {
+        ++length;
+    }
+
+    if (length <= part_length) {
+        return offer(queue, text);
+    }
+
+    /* A part lost in the middle would garble the whole record */
+    if (!make_room(queue, (length + part_length - 1) / part_length)) {
+        queue->stats.dropped++;
+        return 0;
+    }
+
+    for (uint32_t start = 0; start < length; start += part_length) {
+        uint32_t slot = queue->insert_position;
+
+        enqueue(queue, text + start);
+
+        if (start + part_length < length) {
+            queue->flags[slot] = MESSAGES_QUEUE_CONTINUED;
+        }
+    }
+
+    queue->stats.enqueued++;
+    update_high_water(queue);
+
+    return 1;
+}
+
+
+RAMFUNC
+uint8_t offer_sample(messages_queue_t *queue, const char *sample) {
+    return offer_flagged(queue, sample, MESSAGES_QUEUE_SAMPLE);
+}
+
+
+void discard_samples(messages_queue_t *queue) {
+    uint32_t kept = 0;
+
+    for (uint32_t i = 0; i < queue->used_space; ++i) {
+        uint32_t from = (queue->read_position + i) % MESSAGES_QUEUE_BUFFER_SIZE;
+        uint32_t to = (queue->read_position + kept) % MESSAGES_QUEUE_BUFFER_SIZE;
+
+        if (queue->flags[from] & MESSAGES_QUEUE_SAMPLE) {
+            queue->stats.dropped++;
+            continue;
+        }
+
+        if (to != from) {
+            copy_message(queue->messages[to], queue->messages[from]);
+            queue->flags[to] = queue->flags[from];
+        }
+
+        ++kept;
+    }
+
+    queue->used_space = kept;
+    queue->insert_position = (queue->read_position + kept) % MESSAGES_QUEUE_BUFFER_SIZE;
+}
+
+
+void reset_queue_stats(messages_queue_t *queue) {
+    queue->stats.enqueued = 0;
+    queue->stats.dropped = 0;
+    queue->stats.high_water = queue->used_space;
+}
+
+
+static
+char *write_decimal(char *text, uint32_t value) {
+    char digits[10];
+    int length = 0;
+
+    do {
+        digits[length++] = (value % 10) + '0';
+        value /= 10;
+    } while (value > 0);
+
+    while (length > 0) {
+        *text++ = digits[--length];
+    }
+
+    return text;
+}
+
+
+void format_queue_stats(messages_queue_t *queue, char *text) {
+    *text++ = 'Q';
+    *text++ = 'E';
+    text = write_decimal(text, queue->stats.enqueued);
+    *text++ = 'D';
+    text = write_decimal(text, queue->stats.dropped);
+    *text++ = 'H';
+    text = write_decimal(text, queue->stats.high_water);
+    *text++ = '\r';
+    *text++ = '\n';
+    *text = '\0';
+}
@@ -2,14 +2,58 @@
 #define MESSAGES_QUEUE_H
 
 
+/* A message holds the longest sample, tagged with its sensor as in
+ * D0X128Y004Z056 followed by CR LF, and the terminator
+ */
 #define MESSAGES_QUEUE_BUFFER_SIZE                512
+#define MESSAGES_QUEUE_MESSAGE_SIZE                18
+#define MESSAGES_QUEUE_STATS_TEXT_SIZE             40
 
 
+/* Flags of a message followed by the rest of the same text and of an
+ * acceleration sample
+ */
+#define MESSAGES_QUEUE_CONTINUED                 0x01
+#define MESSAGES_QUEUE_SAMPLE                    0x02
+
+
+/* Behaviour of the queue when a message arrives and there is no free slot:
+ * the new message is dropped, the oldest ones are dropped until it fits,
+ * or a new sample overwrites the newest queued sample and other messages
+ * drop the oldest ones. A text spanning several messages is always
+ * dropped whole, and once its first part has been polled the rest of it
+ * is kept and the new message is dropped instead.
+ */
+typedef enum {
+    QUEUE_POLICY_DROP_NEWEST,
+    QUEUE_POLICY_DROP_OLDEST,
+    QUEUE_POLICY_COALESCE
+} queue_policy_t;
+
+
+/* Backpressure counters, kept until reset_queue_stats() is called */
+typedef struct {
+    uint32_t enqueued;
+    uint32_t dropped;
+    uint32_t high_water;
+} queue_stats_t;
+
+
+/* Messages are copied into the queue, so the caller may reuse its buffer
+ * right after offering a message
+ */
 typedef struct {
-    char *messages[MESSAGES_QUEUE_BUFFER_SIZE];
+    char messages[MESSAGES_QUEUE_BUFFER_SIZE][MESSAGES_QUEUE_MESSAGE_SIZE];
+    uint8_t flags[MESSAGES_QUEUE_BUFFER_SIZE];
     uint32_t read_position;
     uint32_t insert_position;
     uint32_t used_space;
+
+    /* Set while the rest of a partly polled text is queued */
+    uint8_t polling_text;
+
+    queue_policy_t policy;
+    queue_stats_t stats;
 } messages_queue_t;
 
 
@@ -22,10 +66,43 @@ uint8_t is_queue_empty(messages_queue_t *);
 uint8_t is_queue_full(messages_queue_t *);
 
 
-void enqueue(messages_queue_t *, char *);
+void enqueue(messages_queue_t *, const char *);
 
 
 char *poll_queue(messages_queue_t *);
 
 
+void set_queue_policy(messages_queue_t *, queue_policy_t);
+
+
+/* Enqueues the message according to the queue policy and updates the
+ * counters; returns 0 when the message itself was dropped
+ */
+uint8_t offer(messages_queue_t *, const char *);
+
+
+/* Enqueues a text of any length, one longer than a message as messages
+ * holding its consecutive parts, either all of them or none when there
+ * are not enough free slots; returns 0 when the text was dropped
+ */
+uint8_t offer_text(messages_queue_t *, const char *);
+
+
+/* Offers a message marked as an acceleration sample */
+uint8_t offer_sample(messages_queue_t *, const char *);
+
+
+/* Removes the queued samples, counting them as dropped, and keeps the
+ * other messages in order
+ */
+void discard_samples(messages_queue_t *);
+
+
+void reset_queue_stats(messages_queue_t *);
+
+
+/* Writes the counters as "QE<enqueued>D<dropped>H<high water>\r\n" */
+void format_queue_stats(messages_queue_t *, char *);
+
+
 #endif /* MESSAGES_QUEUE_H */
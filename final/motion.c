@@ -0,0 +1,59 @@
+#include <stm32.h>
+#include "motion.h"
+#include "ramfunc.h"
+
+
+#define     AXES_NUMBER                           3
+#define     FIXED_POINT_SHIFT                     8
+
+
+/* Filtered values of the axes, scaled by 2^FIXED_POINT_SHIFT */
+static int32_t filtered[AXES_NUMBER];
+static uint8_t is_filter_seeded;
+static uint32_t still_samples;
+
+
+void motion_reset(void) {
+    is_filter_seeded = 0;
+    still_samples = 0;
+}
+
+
+RAMFUNC
+uint8_t motion_update(int8_t x, int8_t y, int8_t z) {
+    int32_t values[AXES_NUMBER] = {x, y, z};
+    uint8_t moved = 0;
+
+    for (int axis = 0; axis < AXES_NUMBER; ++axis) {
+        int32_t value = values[axis] * (1 << FIXED_POINT_SHIFT);
+
+        if (!is_filter_seeded) {
+            filtered[axis] = value;
+        }
+
+        int32_t deviation = value - filtered[axis];
+
+        if (deviation > MOTION_THRESHOLD << FIXED_POINT_SHIFT ||
+            deviation < -(MOTION_THRESHOLD << FIXED_POINT_SHIFT)) {
+            moved = 1;
+        }
+
+        filtered[axis] += deviation / (1 << MOTION_FILTER_SHIFT);
+    }
+
+    is_filter_seeded = 1;
+
+    if (moved) {
+        still_samples = 0;
+    } else if (still_samples < MOTION_STILL_SAMPLES) {
+        still_samples++;
+    }
+
+    return moved;
+}
+
+
+RAMFUNC
+uint8_t motion_is_still(void) {
+    return still_samples == MOTION_STILL_SAMPLES;
+}
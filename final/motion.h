@@ -0,0 +1,34 @@
+#ifndef MOTION_H
+#define MOTION_H
+
+
+/* Software stillness detector run on every sample: each axis is compared
+ * with its own low-pass filtered value, and the device counts as still
+ * once no axis has left the threshold band for a number of samples.
+ */
+
+
+/* Deviation from the filtered value that counts as motion, in LSB */
+#define MOTION_THRESHOLD                            4
+
+/* Consecutive samples inside the band after which the device is still */
+#define MOTION_STILL_SAMPLES                       40
+
+/* The filter moves by 1/2^shift of the difference on every sample */
+#define MOTION_FILTER_SHIFT                         3
+
+
+/* Forgets the filtered values and marks the device as moving */
+void motion_reset(void);
+
+
+/* Feeds the X, Y and Z values of a sample; returns 1 when the sample
+ * shows motion
+ */
+uint8_t motion_update(int8_t, int8_t, int8_t);
+
+
+uint8_t motion_is_still(void);
+
+
+#endif /* MOTION_H */
@@ -0,0 +1,469 @@
+#ifndef PERIPHERALS_HPP
+#define PERIPHERALS_HPP
+
+#include <stdint.h>
+#include <stm32.h>
+
+
+/* Compile-time description of the STM32F411 pins and peripherals the
+ * board uses. Pins are types carrying their port, number and setup;
+ * PortConfiguration folds the pins of one port into the register masks
+ * and values at compile time, so configuring the port takes a single
+ * read-modify-write of each GPIO register. An alternate function the pin
+ * does not have, a USART or I2C on pins of another peripheral and a DMA
+ * stream without the request fail to compile. USART and I2C types that
+ * are only named, never used, are checked by static_assert(wired<...>).
+ */
+namespace peripherals {
+
+
+enum class Port : uint32_t {
+    A = GPIOA_BASE,
+    B = GPIOB_BASE,
+    C = GPIOC_BASE,
+    D = GPIOD_BASE,
+    E = GPIOE_BASE,
+    H = GPIOH_BASE
+};
+
+
+/* Field values of MODER, OTYPER, OSPEEDR and PUPDR */
+enum class Mode : uint32_t {
+    Input = 0,
+    Output = 1,
+    Alternate = 2,
+    Analog = 3
+};
+
+
+enum class OutputType : uint32_t {
+    PushPull = 0,
+    OpenDrain = 1
+};
+
+
+enum class Speed : uint32_t {
+    Low = 0,
+    Medium = 1,
+    Fast = 2,
+    High = 3
+};
+
+
+enum class Pull : uint32_t {
+    None = 0,
+    Up = 1,
+    Down = 2
+};
+
+
+enum class Trigger {
+    Rising,
+    Falling,
+    Both
+};
+
+
+/* Peripheral signals of the alternate functions */
+enum class Signal {
+    None,
+    Usart1Tx,
+    Usart1Rx,
+    Usart2Tx,
+    Usart2Rx,
+    Usart6Tx,
+    Usart6Rx,
+    I2c1Scl,
+    I2c1Sda,
+    I2c2Scl,
+    I2c2Sda,
+    I2c3Scl,
+    I2c3Sda
+};
+
+
+/* DMA requests */
+enum class Request {
+    Usart1Tx,
+    Usart1Rx,
+    Usart2Tx,
+    Usart2Rx,
+    Usart6Tx,
+    Usart6Rx,
+    I2c1Tx,
+    I2c1Rx,
+    I2c2Tx,
+    I2c2Rx,
+    I2c3Tx,
+    I2c3Rx
+};
+
+
+struct AlternateFunction {
+    Port port;
+    uint8_t pin;
+    Signal signal;
+    uint8_t number;
+};
+
+
+/* Alternate functions of the signals above, STM32F411 datasheet table 9 */
+constexpr AlternateFunction ALTERNATE_FUNCTIONS[] = {
+        {Port::A, 2,  Signal::Usart2Tx, 7},
+        {Port::A, 3,  Signal::Usart2Rx, 7},
+        {Port::D, 5,  Signal::Usart2Tx, 7},
+        {Port::D, 6,  Signal::Usart2Rx, 7},
+        {Port::A, 9,  Signal::Usart1Tx, 7},
+        {Port::A, 10, Signal::Usart1Rx, 7},
+        {Port::A, 15, Signal::Usart1Tx, 7},
+        {Port::B, 3,  Signal::Usart1Rx, 7},
+        {Port::B, 6,  Signal::Usart1Tx, 7},
+        {Port::B, 7,  Signal::Usart1Rx, 7},
+        {Port::A, 11, Signal::Usart6Tx, 8},
+        {Port::A, 12, Signal::Usart6Rx, 8},
+        {Port::C, 6,  Signal::Usart6Tx, 8},
+        {Port::C, 7,  Signal::Usart6Rx, 8},
+        {Port::B, 6,  Signal::I2c1Scl,  4},
+        {Port::B, 7,  Signal::I2c1Sda,  4},
+        {Port::B, 8,  Signal::I2c1Scl,  4},
+        {Port::B, 9,  Signal::I2c1Sda,  4},
+        {Port::B, 10, Signal::I2c2Scl,  4},
+        {Port::B, 3,  Signal::I2c2Sda,  9},
+        {Port::B, 9,  Signal::I2c2Sda,  9},
+        {Port::A, 8,  Signal::I2c3Scl,  4},
+        {Port::C, 9,  Signal::I2c3Sda,  4},
+        {Port::B, 4,  Signal::I2c3Sda,  9},
+        {Port::B, 8,  Signal::I2c3Sda,  9}
+};
+
+
+struct DmaMapping {
+    uint8_t controller;
+    uint8_t stream;
+    uint8_t channel;
+    Request request;
+};
+
+
+/* Streams and channels of the requests above, RM0383 tables 27 and 28 */
+constexpr DmaMapping DMA_MAPPINGS[] = {
+        {1, 0, 1, Request::I2c1Rx},
+        {1, 5, 1, Request::I2c1Rx},
+        {1, 6, 1, Request::I2c1Tx},
+        {1, 7, 1, Request::I2c1Tx},
+        {1, 2, 7, Request::I2c2Rx},
+        {1, 3, 7, Request::I2c2Rx},
+        {1, 7, 7, Request::I2c2Tx},
+        {1, 2, 3, Request::I2c3Rx},
+        {1, 4, 3, Request::I2c3Tx},
+        {1, 5, 4, Request::Usart2Rx},
+        {1, 6, 4, Request::Usart2Tx},
+        {2, 2, 4, Request::Usart1Rx},
+        {2, 5, 4, Request::Usart1Rx},
+        {2, 7, 4, Request::Usart1Tx},
+        {2, 1, 5, Request::Usart6Rx},
+        {2, 2, 5, Request::Usart6Rx},
+        {2, 6, 5, Request::Usart6Tx},
+        {2, 7, 5, Request::Usart6Tx}
+};
+
+
+/* Alternate function number of the signal on the pin, -1 if it has none */
+constexpr int alternate_function(Port port, unsigned pin, Signal signal) {
+    for (const AlternateFunction &entry : ALTERNATE_FUNCTIONS) {
+        if (entry.port == port && entry.pin == pin && entry.signal == signal) {
+            return entry.number;
+        }
+    }
+
+    return -1;
+}
+
+
+/* Channel of the request on the stream, -1 if the stream cannot serve it */
+constexpr int dma_channel(unsigned controller, unsigned stream, Request request) {
+    for (const DmaMapping &entry : DMA_MAPPINGS) {
+        if (entry.controller == controller && entry.stream == stream && entry.request == request) {
+            return entry.channel;
+        }
+    }
+
+    return -1;
+}
+
+
+template <Port P, unsigned N, Signal S>
+constexpr unsigned checked_alternate_function() {
+    constexpr int number = alternate_function(P, N, S);
+
+    static_assert(number >= 0, "the signal is not available on this pin");
+
+    return number;
+}
+
+
+template <Port P,
+          unsigned N,
+          Mode M,
+          OutputType T = OutputType::PushPull,
+          Speed S = Speed::Low,
+          Pull U = Pull::None,
+          Signal F = Signal::None,
+          unsigned A = 0>
+struct Pin {
+    static_assert(N < 16, "a port has 16 pins");
+
+    static constexpr Port port = P;
+    static constexpr unsigned number = N;
+    static constexpr Mode mode = M;
+    static constexpr OutputType output_type = T;
+    static constexpr Speed speed = S;
+    static constexpr Pull pull = U;
+    static constexpr Signal signal = F;
+    static constexpr unsigned alternate = A;
+    static constexpr uint32_t mask = 1U << N;
+
+    static GPIO_TypeDef *gpio() {
+        return reinterpret_cast<GPIO_TypeDef *>(static_cast<uint32_t>(P));
+    }
+
+    static void set() {
+        gpio()->BSRR = mask;
+    }
+
+    static void reset() {
+        gpio()->BSRR = mask << 16;
+    }
+
+    static bool read() {
+        return (gpio()->IDR & mask) != 0;
+    }
+};
+
+
+template <Port P, unsigned N, Speed S = Speed::Low, OutputType T = OutputType::PushPull>
+using OutputPin = Pin<P, N, Mode::Output, T, S>;
+
+
+template <Port P, unsigned N, Pull U = Pull::None>
+using InputPin = Pin<P, N, Mode::Input, OutputType::PushPull, Speed::Low, U>;
+
+
+template <Port P,
+          unsigned N,
+          Signal F,
+          OutputType T = OutputType::PushPull,
+          Speed S = Speed::Low,
+          Pull U = Pull::None>
+using AlternatePin = Pin<P, N, Mode::Alternate, T, S, U, F, checked_alternate_function<P, N, F>()>;
+
+
+/* Register values of the pins of one port, computed at compile time */
+template <Port P, typename... Pins>
+struct PortConfiguration {
+    static_assert(((Pins::port == P) && ...), "all pins must be on the port");
+
+    static constexpr uint32_t used = (0U | ... | Pins::mask);
+
+    static_assert((0U + ... + Pins::mask) == used, "a pin is configured twice");
+
+    static constexpr uint32_t field_mask = (0U | ... | (3U << 2 * Pins::number));
+    static constexpr uint32_t moder = (0U | ... | (static_cast<uint32_t>(Pins::mode) << 2 * Pins::number));
+    static constexpr uint32_t otyper = (0U | ... | (static_cast<uint32_t>(Pins::output_type) << Pins::number));
+    static constexpr uint32_t ospeedr = (0U | ... | (static_cast<uint32_t>(Pins::speed) << 2 * Pins::number));
+    static constexpr uint32_t pupdr = (0U | ... | (static_cast<uint32_t>(Pins::pull) << 2 * Pins::number));
+
+    static constexpr uint32_t afr_mask[2] = {
+            (0U | ... | (Pins::number < 8 && Pins::mode == Mode::Alternate ? 0xFU << 4 * Pins::number : 0U)),
+            (0U | ... | (Pins::number >= 8 && Pins::mode == Mode::Alternate ? 0xFU << 4 * (Pins::number - 8) : 0U))
+    };
+
+    static constexpr uint32_t afr[2] = {
+            (0U | ... | (Pins::number < 8 ? Pins::alternate << 4 * Pins::number : 0U)),
+            (0U | ... | (Pins::number >= 8 ? Pins::alternate << 4 * (Pins::number - 8) : 0U))
+    };
+
+    /* MODER goes last, so each pin switches mode with the rest of its
+     * setup already in place
+     */
+    static void configure() {
+        GPIO_TypeDef *gpio = reinterpret_cast<GPIO_TypeDef *>(static_cast<uint32_t>(P));
+
+        gpio->OTYPER = (gpio->OTYPER & ~used) | otyper;
+        gpio->OSPEEDR = (gpio->OSPEEDR & ~field_mask) | ospeedr;
+        gpio->PUPDR = (gpio->PUPDR & ~field_mask) | pupdr;
+
+        if constexpr (afr_mask[0] != 0) {
+            gpio->AFR[0] = (gpio->AFR[0] & ~afr_mask[0]) | afr[0];
+        }
+
+        if constexpr (afr_mask[1] != 0) {
+            gpio->AFR[1] = (gpio->AFR[1] & ~afr_mask[1]) | afr[1];
+        }
+
+        gpio->MODER = (gpio->MODER & ~field_mask) | moder;
+    }
+};
+
+
+/* EXTI line of an input pin; SYSCFG must be clocked */
+template <typename InputPin, Trigger T>
+struct ExtiLine {
+    static_assert(InputPin::mode == Mode::Input, "EXTI lines need input pins");
+
+    static constexpr unsigned line = InputPin::number;
+    static constexpr uint32_t mask = InputPin::mask;
+    static constexpr uint32_t port_index =
+            (static_cast<uint32_t>(InputPin::port) - GPIOA_BASE) / (GPIOB_BASE - GPIOA_BASE);
+    static constexpr uint32_t exticr_shift = 4 * (line % 4);
+
+    static void configure() {
+        SYSCFG->EXTICR[line / 4] = (SYSCFG->EXTICR[line / 4] & ~(0xFU << exticr_shift)) |
+                                   port_index << exticr_shift;
+
+        if constexpr (T == Trigger::Falling) {
+            EXTI->RTSR &= ~mask;
+        } else {
+            EXTI->RTSR |= mask;
+        }
+
+        if constexpr (T == Trigger::Rising) {
+            EXTI->FTSR &= ~mask;
+        } else {
+            EXTI->FTSR |= mask;
+        }
+
+        EXTI->EMR &= ~mask;
+        EXTI->PR = mask;
+        EXTI->IMR |= mask;
+    }
+};
+
+
+constexpr uint32_t usart_base(unsigned number) {
+    return number == 1 ? USART1_BASE : number == 2 ? USART2_BASE : number == 6 ? USART6_BASE : 0;
+}
+
+
+constexpr Signal usart_tx(unsigned number) {
+    return number == 1 ? Signal::Usart1Tx : number == 2 ? Signal::Usart2Tx : Signal::Usart6Tx;
+}
+
+
+constexpr Signal usart_rx(unsigned number) {
+    return number == 1 ? Signal::Usart1Rx : number == 2 ? Signal::Usart2Rx : Signal::Usart6Rx;
+}
+
+
+constexpr Request usart_tx_request(unsigned number) {
+    return number == 1 ? Request::Usart1Tx : number == 2 ? Request::Usart2Tx : Request::Usart6Tx;
+}
+
+
+constexpr Request usart_rx_request(unsigned number) {
+    return number == 1 ? Request::Usart1Rx : number == 2 ? Request::Usart2Rx : Request::Usart6Rx;
+}
+
+
+template <unsigned N, typename Tx>
+struct UsartTransmitter {
+    static_assert(usart_base(N) != 0, "the STM32F411 has USART1, USART2 and USART6");
+    static_assert(Tx::signal == usart_tx(N), "the TX pin belongs to another peripheral");
+
+    static constexpr unsigned number = N;
+    static constexpr Request tx_request = usart_tx_request(N);
+    static constexpr Request rx_request = usart_rx_request(N);
+
+    /* BRR with 16 times oversampling, rounded to the nearest divider */
+    static constexpr uint32_t brr(uint32_t pclk_hz, uint32_t baud_rate) {
+        return (pclk_hz + baud_rate / 2) / baud_rate;
+    }
+};
+
+
+/* USART on the given pins, Rx void for a transmit-only USART */
+template <unsigned N, typename Tx, typename Rx = void>
+struct Usart : UsartTransmitter<N, Tx> {
+    static_assert(Rx::signal == usart_rx(N), "the RX pin belongs to another peripheral");
+};
+
+
+template <unsigned N, typename Tx>
+struct Usart<N, Tx, void> : UsartTransmitter<N, Tx> {
+};
+
+
+constexpr uint32_t i2c_base(unsigned number) {
+    return number == 1 ? I2C1_BASE : number == 2 ? I2C2_BASE : number == 3 ? I2C3_BASE : 0;
+}
+
+
+constexpr Signal i2c_scl(unsigned number) {
+    return number == 1 ? Signal::I2c1Scl : number == 2 ? Signal::I2c2Scl : Signal::I2c3Scl;
+}
+
+
+constexpr Signal i2c_sda(unsigned number) {
+    return number == 1 ? Signal::I2c1Sda : number == 2 ? Signal::I2c2Sda : Signal::I2c3Sda;
+}
+
+
+constexpr Request i2c_tx_request(unsigned number) {
+    return number == 1 ? Request::I2c1Tx : number == 2 ? Request::I2c2Tx : Request::I2c3Tx;
+}
+
+
+constexpr Request i2c_rx_request(unsigned number) {
+    return number == 1 ? Request::I2c1Rx : number == 2 ? Request::I2c2Rx : Request::I2c3Rx;
+}
+
+
+/* I2C in standard mode on the given pins */
+template <unsigned N, typename Scl, typename Sda>
+struct I2c {
+    static_assert(i2c_base(N) != 0, "the STM32F411 has I2C1, I2C2 and I2C3");
+    static_assert(Scl::signal == i2c_scl(N), "the SCL pin belongs to another peripheral");
+    static_assert(Sda::signal == i2c_sda(N), "the SDA pin belongs to another peripheral");
+    static_assert(Scl::output_type == OutputType::OpenDrain && Sda::output_type == OutputType::OpenDrain,
+                  "I2C pins must be open drain");
+
+    static constexpr unsigned number = N;
+    static constexpr Request tx_request = i2c_tx_request(N);
+    static constexpr Request rx_request = i2c_rx_request(N);
+
+    static constexpr uint32_t ccr(uint32_t pclk_mhz, uint32_t speed_hz) {
+        return pclk_mhz * 1000000 / (speed_hz << 1);
+    }
+
+    static constexpr uint32_t trise(uint32_t pclk_mhz) {
+        return pclk_mhz + 1;
+    }
+};
+
+
+/* DMA stream serving the request */
+template <unsigned Controller, unsigned Stream, Request R>
+struct Dma {
+    static_assert(dma_channel(Controller, Stream, R) >= 0, "the stream cannot serve the request");
+
+    static constexpr unsigned channel = dma_channel(Controller, Stream, R);
+    static constexpr uint32_t channel_bits = channel << 25;
+
+    /* Address of the stream registers, for checking the DMAx_Streamy
+     * the C code names
+     */
+    static constexpr uint32_t address = (Controller == 1 ? DMA1_BASE : DMA2_BASE) + 0x10 + 0x18 * Stream;
+};
+
+
+/* Completes the peripheral types, which an alias alone does not, so
+ * their checks run
+ */
+template <typename... Peripherals>
+constexpr bool wired = ((sizeof(Peripherals) > 0) && ...);
+
+
+} /* namespace peripherals */
+
+
+#endif /* PERIPHERALS_HPP */
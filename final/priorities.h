@@ -0,0 +1,19 @@
+#ifndef PRIORITIES_H
+#define PRIORITIES_H
+
+
+/* NVIC priorities of all interrupts used by the program, lower values
+ * preempt higher ones. Handlers are top halves that only touch the
+ * hardware and post deferred work, which runs at the lowest priority
+ * so that formatting and transport never delay the I2C state machine.
+ */
+#define     PRIORITY_I2C                   1
+#define     PRIORITY_SAMPLING_TIMER        2
+#define     PRIORITY_SYSTICK               3
+#define     PRIORITY_ACCELEROMETER_INT     3
+#define     PRIORITY_USART_TX_DMA          3
+#define     PRIORITY_USART_RX              3
+#define     PRIORITY_DEFERRED_WORK        15
+
+
+#endif /* PRIORITIES_H */
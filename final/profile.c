@@ -0,0 +1,41 @@
+#include <stm32.h>
+#include "profile.h"
+
+
+volatile uint32_t profile_max_cycles[PROFILE_POINTS_NUMBER];
+
+
+static const char PROFILE_TAGS[PROFILE_POINTS_NUMBER] = {'I', 'T', 'D'};
+
+
+static
+char *write_decimal(char *text, uint32_t value) {
+    char digits[10];
+    int length = 0;
+
+    do {
+        digits[length++] = value % 10 + '0';
+        value /= 10;
+    } while (value > 0);
+
+    while (length > 0) {
+        *text++ = digits[--length];
+    }
+
+    return text;
+}
+
+
+void format_profile(char *text) {
+    *text++ = 'W';
+
+    for (int point = 0; point < PROFILE_POINTS_NUMBER; ++point) {
+        *text++ = PROFILE_TAGS[point];
+        text = write_decimal(text, profile_max_cycles[point]);
+        profile_max_cycles[point] = 0;
+    }
+
+    *text++ = '\r';
+    *text++ = '\n';
+    *text = '\0';
+}
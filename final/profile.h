@@ -0,0 +1,45 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+
+/* Worst-case cycle counts of the hot interrupt handlers, measured with
+ * the DWT cycle counter from the first to the last instruction of the
+ * handler body
+ */
+
+
+typedef enum {
+    PROFILE_I2C,
+    PROFILE_SAMPLING_TIMER,
+    PROFILE_USART_TX_DMA,
+    PROFILE_POINTS_NUMBER
+} profile_point_t;
+
+
+#define PROFILE_TEXT_SIZE                          40
+
+
+extern volatile uint32_t profile_max_cycles[PROFILE_POINTS_NUMBER];
+
+
+static inline uint32_t profile_start(void) {
+    return DWT->CYCCNT;
+}
+
+
+static inline void profile_end(profile_point_t point, uint32_t start) {
+    uint32_t cycles = DWT->CYCCNT - start;
+
+    if (cycles > profile_max_cycles[point]) {
+        profile_max_cycles[point] = cycles;
+    }
+}
+
+
+/* Writes "WI<I2C>T<sampling timer>D<USART TX DMA>\r\n" with the worst
+ * cases since the last call, and starts measuring anew
+ */
+void format_profile(char *);
+
+
+#endif /* PROFILE_H */
@@ -0,0 +1,41 @@
+#include <stm32.h>
+#include "ramfunc.h"
+
+
+/* Defined by ramfunc.lds */
+extern uint32_t __ramfunc_load__;
+extern uint32_t __ramfunc_start__;
+extern uint32_t __ramfunc_end__;
+
+
+static uint32_t ram_vectors[VECTORS_NUMBER] __attribute__((aligned(VECTORS_ALIGNMENT)));
+
+
+void ramfunc_init(void) {
+#ifdef USE_RAMFUNC
+    const uint32_t *source = &__ramfunc_load__;
+
+    for (uint32_t *target = &__ramfunc_start__; target < &__ramfunc_end__; ++target) {
+        *target = *source++;
+    }
+
+    __DSB();
+    __ISB();
+#endif
+}
+
+
+void vectors_relocate(void) {
+    const uint32_t *vectors = (const uint32_t *) SCB->VTOR;
+
+    __disable_irq();
+
+    for (uint32_t i = 0; i < VECTORS_NUMBER; ++i) {
+        ram_vectors[i] = vectors[i];
+    }
+
+    SCB->VTOR = (uint32_t) ram_vectors;
+
+    __DSB();
+    __enable_irq();
+}
@@ -0,0 +1,36 @@
+#ifndef RAMFUNC_H
+#define RAMFUNC_H
+
+
+/* Hot code placed in SRAM, where it runs without flash wait states.
+ * Functions marked RAMFUNC go to the .ramfunc section, linked to run in
+ * SRAM and loaded in flash (ramfunc.lds); ramfunc_init() copies them
+ * before the first call. Building with RAMFUNC=0 leaves everything in
+ * flash, for comparing cycle counts.
+ */
+#ifdef USE_RAMFUNC
+#define RAMFUNC       __attribute__((section(".ramfunc"), long_call, noinline))
+#else
+#define RAMFUNC
+#endif
+
+
+/* Number of entries of the STM32F411 vector table: the stack pointer,
+ * 15 system exceptions and 86 interrupts; VTOR needs the table aligned
+ * to the next power of two of its size
+ */
+#define VECTORS_NUMBER                            102
+#define VECTORS_ALIGNMENT                         512
+
+
+/* Copies the .ramfunc section from flash to SRAM, to be called first */
+void ramfunc_init(void);
+
+
+/* Copies the vector table to SRAM and points VTOR at it, so interrupt
+ * entry does not fetch the handler address from flash
+ */
+void vectors_relocate(void);
+
+
+#endif /* RAMFUNC_H */
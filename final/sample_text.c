@@ -0,0 +1,52 @@
+#include <stm32.h>
+#include "command_parser.h"
+#include "sample_text.h"
+
+
+#define     REGISTER_VALUE_DECIMAL_LENGTH         3
+
+
+static const char HEX_DIGITS[] = "0123456789ABCDEF";
+
+
+static
+char *write_value(char *text, uint8_t value, uint8_t format) {
+    if (format == COMMAND_FORMAT_HEXADECIMAL) {
+        *text++ = HEX_DIGITS[value >> 4];
+        *text++ = HEX_DIGITS[value & 0xF];
+
+        return text;
+    }
+
+    for (int i = REGISTER_VALUE_DECIMAL_LENGTH - 1; i >= 0; --i) {
+        text[i] = (value % 10) + '0';
+        value /= 10;
+    }
+
+    return text + REGISTER_VALUE_DECIMAL_LENGTH;
+}
+
+
+uint32_t format_sample(char *text, const uint8_t *values, uint8_t axes, uint8_t format) {
+    char *start = text;
+
+    for (int axis = 0; axis < SAMPLE_AXES_NUMBER; ++axis) {
+        if (axes & (COMMAND_AXIS_X << axis)) {
+            *text++ = 'X' + axis;
+            text = write_value(text, values[axis], format);
+        }
+    }
+
+    *text++ = '\r';
+    *text++ = '\n';
+
+    return text - start;
+}
+
+
+uint32_t format_sensor_tag(char *text, uint8_t sensor) {
+    text[0] = 'D';
+    text[1] = '0' + sensor;
+
+    return SENSOR_TAG_LENGTH;
+}
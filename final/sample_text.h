@@ -0,0 +1,32 @@
+#ifndef SAMPLE_TEXT_H
+#define SAMPLE_TEXT_H
+
+
+/* Text records of acceleration samples shared by all outputs */
+
+
+#define SAMPLE_AXES_NUMBER                          3
+
+/* Longest record, three decimal axes and CR LF, without a terminator */
+#define SAMPLE_TEXT_MAX_LENGTH                     14
+
+/* Length of the "D<sensor>" tag of the records of one of several sensors */
+#define SENSOR_TAG_LENGTH                           2
+
+
+/* Writes the selected axes of the X, Y and Z values, e.g. X128Y004 or,
+ * in the hexadecimal format, X80Y04, followed by CR LF; takes the axes
+ * and format as in COMMAND_AXES and COMMAND_FORMAT, returns the length
+ * and does not terminate the text
+ */
+uint32_t format_sample(char *, const uint8_t *, uint8_t, uint8_t);
+
+
+/* Writes the "D<sensor>" tag put before the sample and summary records
+ * when several sensors are sampled, sensors 0 to 9; returns the length
+ * and does not terminate the text
+ */
+uint32_t format_sensor_tag(char *, uint8_t);
+
+
+#endif /* SAMPLE_TEXT_H */
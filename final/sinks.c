@@ -0,0 +1,117 @@
+#include <stm32.h>
+#include "sample_text.h"
+#include "sinks.h"
+
+
+#define     SINKS_MAX_NUMBER                      4
+
+
+static uint8_t samples[SINKS_SAMPLES_RING_SIZE][SAMPLE_AXES_NUMBER];
+static uint32_t samples_write_position;
+
+
+static sink_t *sinks[SINKS_MAX_NUMBER];
+static uint32_t sinks_number;
+
+
+void sink_register(sink_t *sink, uint32_t brr, uint32_t channel_bits) {
+    if (sinks_number == SINKS_MAX_NUMBER) {
+        return;
+    }
+
+    sink->usart->CR1 = USART_CR1_TE;
+    sink->usart->CR2 = 0;
+    sink->usart->BRR = brr;
+    sink->usart->CR3 = USART_CR3_DMAT;
+
+    sink->stream->CR = channel_bits |
+                       DMA_SxCR_PL_0 |
+                       DMA_SxCR_MINC |
+                       DMA_SxCR_DIR_0 |
+                       DMA_SxCR_TCIE;
+
+    sink->stream->PAR = (uint32_t) & sink->usart->DR;
+
+    *sink->dma_clear = sink->complete_flag;
+
+    if (sink->decimation == 0) {
+        sink->decimation = 1;
+    }
+
+    sink->read_position = samples_write_position;
+    sink->dropped_samples = 0;
+
+    sinks[sinks_number++] = sink;
+
+    sink->usart->CR1 |= USART_CR1_UE;
+}
+
+
+static
+uint8_t is_sink_idle(sink_t *sink) {
+    return (sink->stream->CR & DMA_SxCR_EN) == 0 &&
+           (*sink->dma_status & sink->complete_flag) == 0;
+}
+
+
+/* Formats the pending samples selected by the decimation into the buffer
+ * while they fit and starts the transfer
+ */
+static
+void start_sink(sink_t *sink) {
+    uint32_t length = 0;
+
+    while (sink->read_position != samples_write_position &&
+           length + SAMPLE_TEXT_MAX_LENGTH <= SINK_BUFFER_SIZE) {
+        uint32_t position = sink->read_position++;
+
+        if (position % sink->decimation == 0) {
+            length += format_sample(sink->buffer + length,
+                                    samples[position % SINKS_SAMPLES_RING_SIZE],
+                                    sink->axes,
+                                    sink->format);
+        }
+    }
+
+    if (length > 0) {
+        sink->stream->M0AR = (uint32_t) sink->buffer;
+        sink->stream->NDTR = length;
+        sink->stream->CR |= DMA_SxCR_EN;
+    }
+}
+
+
+void sinks_service(void) {
+    for (uint32_t i = 0; i < sinks_number; ++i) {
+        if (is_sink_idle(sinks[i])) {
+            start_sink(sinks[i]);
+        }
+    }
+}
+
+
+void sinks_publish(const uint8_t *values) {
+    uint8_t *slot = samples[samples_write_position % SINKS_SAMPLES_RING_SIZE];
+
+    for (int axis = 0; axis < SAMPLE_AXES_NUMBER; ++axis) {
+        slot[axis] = values[axis];
+    }
+
+    samples_write_position++;
+
+    for (uint32_t i = 0; i < sinks_number; ++i) {
+        sink_t *sink = sinks[i];
+
+        if (samples_write_position - sink->read_position > SINKS_SAMPLES_RING_SIZE) {
+            sink->dropped_samples++;
+            sink->read_position = samples_write_position - SINKS_SAMPLES_RING_SIZE;
+        }
+    }
+
+    sinks_service();
+}
+
+
+void sink_transfer_complete(sink_t *sink) {
+    *sink->dma_clear = sink->complete_flag;
+}
@@ -0,0 +1,69 @@
+#ifndef SINKS_H
+#define SINKS_H
+
+
+/* Additional USART outputs fed with the same acceleration samples as
+ * USART2. Samples are published once into a shared ring of raw values;
+ * every sink keeps its own position in it and formats the samples it
+ * sends straight into its DMA buffer, in its own format and at its own
+ * rate, so a slow sink never holds up another one.
+ */
+
+
+/* Number of raw samples kept for the sinks, a power of two */
+#define SINKS_SAMPLES_RING_SIZE                   256
+
+/* Size of the buffer each sink transmits from */
+#define SINK_BUFFER_SIZE                          128
+
+
+typedef struct {
+    USART_TypeDef *usart;
+    DMA_Stream_TypeDef *stream;
+
+    /* Transfer-complete flag of the stream and its status and clear
+     * registers, e.g. DMA_HISR_TCIF7 in DMA2->HISR and DMA2->HIFCR
+     */
+    volatile uint32_t *dma_status;
+    volatile uint32_t *dma_clear;
+    uint32_t complete_flag;
+
+    /* Output settings: axes and format as in COMMAND_AXES and
+     * COMMAND_FORMAT, and every how many samples one is sent
+     */
+    uint8_t axes;
+    uint8_t format;
+    uint32_t decimation;
+
+    uint32_t read_position;
+    uint32_t dropped_samples;
+    char buffer[SINK_BUFFER_SIZE];
+} sink_t;
+
+
+/* Configures the USART for transmission only with the BRR value and the
+ * DMA stream with the CR channel bits, both from board.h, and registers
+ * the sink; the pins, clocks and the stream interrupt are set up by the
+ * caller
+ */
+void sink_register(sink_t *, uint32_t, uint32_t);
+
+
+/* Stores the X, Y and Z values of a sample for all sinks and starts the
+ * idle ones; a sink that falls a whole ring behind loses the oldest
+ * samples. For deferred work.
+ */
+void sinks_publish(const uint8_t *);
+
+
+/* Clears the transfer-complete flag, to be called from the stream
+ * interrupt; the sink is restarted by the next sinks_service()
+ */
+void sink_transfer_complete(sink_t *);
+
+
+/* Starts every idle sink that has samples to send. For deferred work. */
+void sinks_service(void);
+
+
+#endif /* SINKS_H */
@@ -0,0 +1,117 @@
+#include <stm32.h>
+#include "ramfunc.h"
+#include "stream.h"
+
+
+/* Written by deferred work and read by the DMA interrupt; the positions
+ * move only after the bytes they cover
+ */
+static uint8_t ring[STREAM_RING_SIZE];
+static volatile uint32_t write_position;
+static volatile uint32_t read_position;
+
+
+static uint8_t buffers[2][STREAM_HALF_SIZE];
+
+
+/* Number of data bytes, not padding, in each of the buffers */
+static uint32_t buffer_data_length[2];
+
+
+static volatile uint8_t running;
+static uint32_t dropped_bytes;
+
+
+uint32_t stream_free_space(void) {
+    return STREAM_RING_SIZE - (write_position - read_position);
+}
+
+
+uint8_t stream_write(const void *data, uint32_t length) {
+    const uint8_t *bytes = data;
+
+    if (length > stream_free_space()) {
+        dropped_bytes += length;
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < length; ++i) {
+        ring[(write_position + i) & (STREAM_RING_SIZE - 1)] = bytes[i];
+    }
+
+    __DMB();
+    write_position += length;
+
+    return 1;
+}
+
+
+uint8_t stream_is_running(void) {
+    return running;
+}
+
+
+static RAMFUNC
+void fill_buffer(uint32_t index) {
+    uint32_t pending = write_position - read_position;
+    uint32_t length = pending < STREAM_HALF_SIZE ? pending : STREAM_HALF_SIZE;
+    uint8_t *buffer = buffers[index];
+
+    for (uint32_t i = 0; i < length; ++i) {
+        buffer[i] = ring[(read_position + i) & (STREAM_RING_SIZE - 1)];
+    }
+
+    for (uint32_t i = length; i < STREAM_HALF_SIZE; ++i) {
+        buffer[i] = STREAM_PADDING_BYTE;
+    }
+
+    __DMB();
+    read_position += length;
+    buffer_data_length[index] = length;
+}
+
+
+void stream_start(void) {
+    if (running || write_position == read_position ||
+        (DMA1_Stream6->CR & DMA_SxCR_EN)) {
+        return;
+    }
+
+    fill_buffer(0);
+    fill_buffer(1);
+
+    DMA1_Stream6->M0AR = (uint32_t) buffers[0];
+    DMA1_Stream6->M1AR = (uint32_t) buffers[1];
+    DMA1_Stream6->NDTR = STREAM_HALF_SIZE;
+
+    DMA1_Stream6->CR = (DMA1_Stream6->CR & ~DMA_SxCR_CT) | DMA_SxCR_DBM;
+    DMA1_Stream6->CR |= DMA_SxCR_EN;
+
+    running = 1;
+}
+
+
+RAMFUNC
+void stream_buffer_complete(void) {
+    if (!running) {
+        return;
+    }
+
+    /* CT already points at the buffer being sent now */
+    uint32_t sending = (DMA1_Stream6->CR & DMA_SxCR_CT) ? 1 : 0;
+    uint32_t finished = sending ^ 1U;
+
+    if (write_position == read_position && buffer_data_length[sending] == 0) {
+        /* Only padding left on the line, cutting it short loses nothing */
+        DMA1_Stream6->CR &= ~DMA_SxCR_EN;
+        running = 0;
+        return;
+    }
+
+    fill_buffer(finished);
+}
+
+
+uint32_t stream_dropped_bytes(void) {
+    return dropped_bytes;
+}
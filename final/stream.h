@@ -0,0 +1,53 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+
+/* Gapless transmission on DMA1_Stream6 in double-buffer mode: the CPU
+ * refills one buffer while the hardware sends the other, so the line
+ * never idles between transfers and the interrupt is taken once per
+ * STREAM_HALF_SIZE bytes
+ */
+
+
+/* Size of each of the two buffers the DMA alternates between */
+#define STREAM_HALF_SIZE                           64
+
+/* Size of the byte ring feeding the buffers, a power of two */
+#define STREAM_RING_SIZE                         2048
+
+/* Byte filling the unused tail of a buffer when the ring runs dry,
+ * ignored by the host receiver
+ */
+#define STREAM_PADDING_BYTE                      0x00
+
+
+/* Appends the bytes to the ring; returns 0 and counts a drop when they
+ * do not fit as a whole
+ */
+uint8_t stream_write(const void *, uint32_t);
+
+
+uint32_t stream_free_space(void);
+
+
+uint8_t stream_is_running(void);
+
+
+/* Starts the transmission when there is pending data and the DMA stream
+ * is disabled
+ */
+void stream_start(void);
+
+
+/* Refills the buffer the hardware has just finished, to be called from
+ * the transfer-complete interrupt itself: by the next one the DMA sends
+ * that buffer again, so the refill cannot wait for deferred work. Stops
+ * the stream once both buffers hold only padding.
+ */
+void stream_buffer_complete(void);
+
+
+uint32_t stream_dropped_bytes(void);
+
+
+#endif /* STREAM_H */
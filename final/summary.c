@@ -0,0 +1,133 @@
+#include <stm32.h>
+#include "command_parser.h"
+#include "ramfunc.h"
+#include "summary.h"
+
+
+#define     DECIMALS_SCALE                      100
+
+
+void summary_reset(summary_t *summary) {
+    summary->samples = 0;
+}
+
+
+RAMFUNC
+void summary_update(summary_t *summary, int8_t x, int8_t y, int8_t z) {
+    int8_t values[SUMMARY_AXES_NUMBER] = {x, y, z};
+    uint32_t samples = ++summary->samples;
+
+    for (int axis = 0; axis < SUMMARY_AXES_NUMBER; ++axis) {
+        summary_axis_t *statistics = &summary->axes[axis];
+        int32_t value = values[axis] * (1 << SUMMARY_FRACTION_BITS);
+
+        if (samples == 1) {
+            statistics->min = values[axis];
+            statistics->max = values[axis];
+            statistics->mean = value;
+            statistics->squared_deviations = 0;
+            continue;
+        }
+
+        if (values[axis] < statistics->min) {
+            statistics->min = values[axis];
+        }
+
+        if (values[axis] > statistics->max) {
+            statistics->max = values[axis];
+        }
+
+        /* The truncated step keeps value - mean on the side of delta, so
+         * the product never goes negative
+         */
+        int32_t delta = value - statistics->mean;
+
+        statistics->mean += delta / (int32_t) samples;
+        statistics->squared_deviations += (int64_t) delta * (value - statistics->mean);
+    }
+}
+
+
+void summary_take(summary_t *summary, summary_t *window) {
+    *window = *summary;
+    summary->samples = 0;
+}
+
+
+static
+char *write_number(char *text, uint32_t value) {
+    char digits[10];
+    int length = 0;
+
+    do {
+        digits[length++] = value % 10 + '0';
+        value /= 10;
+    } while (value > 0);
+
+    while (length > 0) {
+        *text++ = digits[--length];
+    }
+
+    return text;
+}
+
+
+static
+char *write_signed(char *text, int32_t value) {
+    if (value < 0) {
+        *text++ = '-';
+        value = -value;
+    }
+
+    return write_number(text, value);
+}
+
+
+/* Writes a value scaled by 2^shift rounded to two decimals */
+static
+char *write_fixed(char *text, int64_t value, uint32_t shift) {
+    if (value < 0) {
+        *text++ = '-';
+        value = -value;
+    }
+
+    uint32_t hundredths = (value * DECIMALS_SCALE + (1LL << (shift - 1))) >> shift;
+
+    text = write_number(text, hundredths / DECIMALS_SCALE);
+    *text++ = '.';
+    *text++ = hundredths / 10 % 10 + '0';
+    *text++ = hundredths % 10 + '0';
+
+    return text;
+}
+
+
+uint32_t format_summary(char *text, const summary_t *window, uint8_t axes) {
+    char *start = text;
+
+    *text++ = 'S';
+    text = write_number(text, window->samples);
+
+    for (int axis = 0; axis < SUMMARY_AXES_NUMBER; ++axis) {
+        const summary_axis_t *statistics = &window->axes[axis];
+
+        if (!(axes & (COMMAND_AXIS_X << axis))) {
+            continue;
+        }
+
+        *text++ = 'X' + axis;
+        text = write_signed(text, statistics->min);
+        *text++ = ',';
+        text = write_signed(text, statistics->max);
+        *text++ = ',';
+        text = write_fixed(text, statistics->mean, SUMMARY_FRACTION_BITS);
+        *text++ = ',';
+        text = write_fixed(text, statistics->squared_deviations / window->samples,
+                           2 * SUMMARY_FRACTION_BITS);
+    }
+
+    *text++ = '\r';
+    *text++ = '\n';
+
+    return text - start;
+}
@@ -0,0 +1,58 @@
+#ifndef SUMMARY_H
+#define SUMMARY_H
+
+
+/* Per-axis statistics of the samples of a window: minimum, maximum and
+ * the running mean and sum of squared deviations of Welford's algorithm,
+ * updated in constant time on every sample. The mean is kept scaled by
+ * 2^SUMMARY_FRACTION_BITS and the sum by its square.
+ */
+
+
+#define SUMMARY_AXES_NUMBER                         3
+#define SUMMARY_FRACTION_BITS                      16
+
+/* Longest record, "S" with the sample count and three axes of
+ * "X-128,-128,-128.00,16384.00", and CR LF, without a terminator
+ */
+#define SUMMARY_TEXT_MAX_LENGTH                    94
+
+
+typedef struct {
+    int8_t min;
+    int8_t max;
+    int32_t mean;
+    uint64_t squared_deviations;
+} summary_axis_t;
+
+
+typedef struct {
+    uint32_t samples;
+    summary_axis_t axes[SUMMARY_AXES_NUMBER];
+} summary_t;
+
+
+/* Starts a new window */
+void summary_reset(summary_t *);
+
+
+/* Feeds the X, Y and Z values of a sample to the window */
+void summary_update(summary_t *, int8_t, int8_t, int8_t);
+
+
+/* Copies the statistics of the window given first into the second and
+ * starts a new window; the caller keeps summary_update() from running on
+ * it meanwhile
+ */
+void summary_take(summary_t *, summary_t *);
+
+
+/* Writes "S<samples>" and for each selected axis its letter followed by
+ * "<min>,<max>,<mean>,<variance>", the last two with two decimals, e.g.
+ * S40X-3,5,1.25,0.40Z54,58,56.10,0.90, then CR LF; takes the axes as in
+ * COMMAND_AXES, returns the length and does not terminate the text
+ */
+uint32_t format_summary(char *, const summary_t *, uint8_t);
+
+
+#endif /* SUMMARY_H */
@@ -0,0 +1,251 @@
+#include <stm32.h>
+#include "deferred.h"
+#include "ramfunc.h"
+#include "timers.h"
+
+
+#define     CORE_CLOCK_HZ         16000000U
+#define     TICKS_PER_SECOND           1000U
+#define     WHEEL_MASK     (TIMERS_WHEEL_SLOTS - 1)
+
+
+/* Sentinel heads of the timer lists, one per slot of each level */
+static software_timer_t wheel[TIMERS_WHEEL_LEVELS][TIMERS_WHEEL_SLOTS];
+
+
+/* Ticks counted by SysTick and the tick up to which the wheel has been
+ * processed by the deferred work
+ */
+static volatile uint32_t ticks;
+static uint32_t wheel_ticks;
+
+
+static volatile uint32_t active_timers;
+
+
+static
+void list_init(software_timer_t *head) {
+    head->next = head;
+    head->previous = head;
+}
+
+
+static RAMFUNC
+void list_append(software_timer_t *head, software_timer_t *timer) {
+    timer->previous = head->previous;
+    timer->next = head;
+    head->previous->next = timer;
+    head->previous = timer;
+}
+
+
+static RAMFUNC
+void list_remove(software_timer_t *timer) {
+    timer->previous->next = timer->next;
+    timer->next->previous = timer->previous;
+    timer->next = 0;
+    timer->previous = 0;
+}
+
+
+/* Puts the timer into the slot of the lowest level that covers its delay */
+static RAMFUNC
+void wheel_insert(software_timer_t *timer) {
+    uint32_t delta = timer->expires - wheel_ticks;
+    uint32_t level = 0;
+
+    if ((int32_t) delta < 0) {
+        timer->expires = wheel_ticks;
+        delta = 0;
+    }
+
+    while (level + 1 < TIMERS_WHEEL_LEVELS &&
+           delta >= (1U << (TIMERS_WHEEL_BITS * (level + 1)))) {
+        ++level;
+    }
+
+    if (delta >= (1U << (TIMERS_WHEEL_BITS * TIMERS_WHEEL_LEVELS))) {
+        timer->expires = wheel_ticks + (1U << (TIMERS_WHEEL_BITS * TIMERS_WHEEL_LEVELS)) - 1;
+    }
+
+    uint32_t slot = (timer->expires >> (TIMERS_WHEEL_BITS * level)) & WHEEL_MASK;
+
+    list_append(&wheel[level][slot], timer);
+}
+
+
+void timer_setup(software_timer_t *timer, timer_callback_t callback, void *argument) {
+    timer->next = 0;
+    timer->previous = 0;
+    timer->callback = callback;
+    timer->argument = argument;
+    timer->generation = 0;
+    timer->expired_generation = 0;
+}
+
+
+uint8_t timer_is_active(software_timer_t *timer) {
+    return timer->next != 0;
+}
+
+
+uint8_t timer_expiry_is_current(software_timer_t *timer) {
+    return timer->generation == timer->expired_generation;
+}
+
+
+RAMFUNC
+void timer_start(software_timer_t *timer, uint32_t delay, uint32_t period) {
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+
+    if (timer_is_active(timer)) {
+        list_remove(timer);
+    } else {
+        active_timers++;
+    }
+
+    timer->period = period;
+    timer->expires = ticks + delay;
+    timer->generation++;
+    wheel_insert(timer);
+
+    __set_PRIMASK(primask);
+}
+
+
+RAMFUNC
+void timer_cancel(software_timer_t *timer) {
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+
+    if (timer_is_active(timer)) {
+        list_remove(timer);
+        active_timers--;
+    }
+
+    timer->generation++;
+
+    __set_PRIMASK(primask);
+}
+
+
+uint32_t timers_ticks(void) {
+    return ticks;
+}
+
+
+/* Moves the timers of one slot of a higher level down the wheel; returns
+ * the slot index, which is zero when the next level has to cascade too
+ */
+static
+uint32_t cascade(uint32_t level) {
+    uint32_t slot = (wheel_ticks >> (TIMERS_WHEEL_BITS * level)) & WHEEL_MASK;
+    software_timer_t *head = &wheel[level][slot];
+
+    while (head->next != head) {
+        software_timer_t *timer = head->next;
+
+        list_remove(timer);
+        wheel_insert(timer);
+    }
+
+    return slot;
+}
+
+
+/* Runs the timers of the slot of the current tick and advances the wheel */
+static
+void process_tick(void) {
+    software_timer_t expired;
+    software_timer_t *head = &wheel[0][wheel_ticks & WHEEL_MASK];
+
+    list_init(&expired);
+
+    __disable_irq();
+
+    if ((wheel_ticks & WHEEL_MASK) == 0) {
+        for (uint32_t level = 1; level < TIMERS_WHEEL_LEVELS && cascade(level) == 0; ++level) {}
+    }
+
+    while (head->next != head) {
+        software_timer_t *timer = head->next;
+
+        list_remove(timer);
+        list_append(&expired, timer);
+    }
+
+    wheel_ticks++;
+
+    __enable_irq();
+
+    /* Expired timers may still be cancelled until their callback runs */
+    for (;;) {
+        __disable_irq();
+
+        if (expired.next == &expired) {
+            __enable_irq();
+            break;
+        }
+
+        software_timer_t *timer = expired.next;
+
+        list_remove(timer);
+        timer->expired_generation = timer->generation;
+
+        if (timer->period != 0) {
+            timer->expires += timer->period;
+            wheel_insert(timer);
+        } else {
+            active_timers--;
+        }
+
+        __enable_irq();
+
+        timer->callback(timer->argument);
+    }
+}
+
+
+static
+void process_timers(void) {
+    while ((int32_t) (ticks - wheel_ticks) >= 0) {
+        process_tick();
+    }
+}
+
+
+void SysTick_Handler(void) {
+    ticks++;
+
+    if (active_timers != 0) {
+        deferred_post(WORK_TIMERS);
+    }
+}
+
+
+void timers_init(void) {
+    for (uint32_t level = 0; level < TIMERS_WHEEL_LEVELS; ++level) {
+        for (uint32_t slot = 0; slot < TIMERS_WHEEL_SLOTS; ++slot) {
+            list_init(&wheel[level][slot]);
+        }
+    }
+
+    ticks = 0;
+    wheel_ticks = 0;
+
+    deferred_register(WORK_TIMERS, process_timers);
+
+    SysTick_Config(CORE_CLOCK_HZ / TICKS_PER_SECOND);
+}
+
+
+void sleep_ms(uint32_t milliseconds) {
+    uint32_t start = ticks;
+
+    while (ticks - start < milliseconds) {
+        __WFI();
+    }
+}
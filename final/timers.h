@@ -0,0 +1,75 @@
+#ifndef TIMERS_H
+#define TIMERS_H
+
+
+/* Software timers driven by SysTick with a resolution of one millisecond.
+ * Pending timers are kept in a three-level timer wheel of 64 slots per
+ * level, so starting and cancelling a timer takes constant time and the
+ * longest delay is 64^3 ms, about 4.4 minutes. Callbacks run as deferred
+ * work, never in the SysTick handler.
+ */
+
+
+#define TIMERS_WHEEL_BITS                           6
+#define TIMERS_WHEEL_SLOTS      (1U << TIMERS_WHEEL_BITS)
+#define TIMERS_WHEEL_LEVELS                         3
+
+
+typedef void (*timer_callback_t)(void *);
+
+
+typedef struct software_timer {
+    struct software_timer *next;
+    struct software_timer *previous;
+    uint32_t expires;
+    uint32_t period;
+    timer_callback_t callback;
+    void *argument;
+
+    /* Counts starts and cancels; the value at the expiry being handled */
+    uint32_t generation;
+    uint32_t expired_generation;
+} software_timer_t;
+
+
+/* Starts SysTick and registers the deferred work processing timers;
+ * NVIC_configure() sets the SysTick priority afterwards
+ */
+void timers_init(void);
+
+
+void timer_setup(software_timer_t *, timer_callback_t, void *);
+
+
+/* (Re)starts the timer to expire after the given number of milliseconds
+ * and then, when the period is non-zero, every period milliseconds;
+ * callable from any interrupt priority
+ */
+void timer_start(software_timer_t *, uint32_t, uint32_t);
+
+
+void timer_cancel(software_timer_t *);
+
+
+uint8_t timer_is_active(software_timer_t *);
+
+
+/* Returns 0 in a callback when the timer has been started or cancelled
+ * again between its expiry and the callback, which then handles a stale
+ * expiry; interrupts that may do so have to be disabled around the check
+ * and whatever the callback does after it
+ */
+uint8_t timer_expiry_is_current(software_timer_t *);
+
+
+/* Milliseconds since timers_init() */
+uint32_t timers_ticks(void);
+
+
+/* Sleeps with WFI for the given number of milliseconds; only for code
+ * running before the interrupts it would wait for are needed elsewhere
+ */
+void sleep_ms(uint32_t);
+
+
+#endif /* TIMERS_H */
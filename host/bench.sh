@@ -0,0 +1,38 @@
+#!/bin/sh
+# Runs the simulated firmware against the receiver over a pseudo-terminal
+# and prints the receiver's JSON summary. Extra arguments go to pty_feeder;
+# its line speed and sample rate also set up the receiver.
+#
+# usage: ./bench.sh [pty_feeder options]
+
+set -e
+
+cd "$(dirname "$0")"
+
+LINK=$(mktemp -u /tmp/microcontrollers-pty.XXXXXX)
+
+BAUD=9600
+RATE=40
+PREVIOUS=
+
+for ARGUMENT in "$@"; do
+    case "$PREVIOUS" in
+        -b) BAUD=$ARGUMENT ;;
+        -r) RATE=$ARGUMENT ;;
+    esac
+
+    PREVIOUS=$ARGUMENT
+done
+
+./pty_feeder -s 200 -l "$LINK" "$@" > /dev/null &
+FEEDER=$!
+
+while [ ! -e "$LINK" ]; do
+    sleep 0.01
+done
+
+./receiver -j -q -b "$BAUD" -p $((1000000 / RATE)) "$LINK" || STATUS=$?
+
+wait "$FEEDER"
+
+exit ${STATUS:-0}
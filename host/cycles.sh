@@ -0,0 +1,27 @@
+#!/bin/sh
+# Reads the worst-case cycle counts of the hot handlers from a running
+# final build: a first CYCLES command restarts the measurement, a second
+# one after the given time returns "WI<I2C>T<sampling timer>D<USART TX
+# DMA>" for that window.
+#
+# usage: ./cycles.sh device [seconds] [baud]
+
+set -e
+
+DEVICE=$1
+DURATION=${2:-10}
+BAUD=${3:-9600}
+
+if [ -z "$DEVICE" ]; then
+    echo "usage: $0 device [seconds] [baud]" >&2
+    exit 2
+fi
+
+stty -F "$DEVICE" "$BAUD" raw -echo
+exec 3< "$DEVICE"
+
+printf 'CYCLES\n' > "$DEVICE"
+sleep "$DURATION"
+printf 'CYCLES\n' > "$DEVICE"
+
+timeout 2 grep -a -m 2 '^W' <&3 | tail -n 1 | tr -d '\r'
@@ -0,0 +1,13 @@
+#ifndef STM32_H
+#define STM32_H
+
+#include <stdint.h>
+
+
+/* Host stand-in for the device header, enough to build the firmware
+ * modules that do not touch peripherals (see pipeline_bench.c)
+ */
+#define __DMB()     __sync_synchronize()
+
+
+#endif /* STM32_H */
@@ -0,0 +1,491 @@
+#include <string.h>
+#include "consts.h"
+#include "lis35de_model.h"
+
+
+#define     CTRL_REG1_POWER_UP                 0x40
+#define     CTRL_REG1_AXES_ENABLE              0x07
+#define     CTRL_REG1_POWER_ON_VALUE           0x07
+#define     CTRL_REG2_HP_FF_WU1                0x04
+#define     CTRL_REG2_HP_FF_WU2                0x08
+
+#define     STATUS_AXES_DATA_AVAILABLE         0x07
+
+#define     SOURCE_IA                          0x40
+#define     CONFIG_AOI                         0x80
+#define     CONFIG_LIR                         0x40
+#define     FF_WU_EVENTS_MASK                  0x3F
+#define     FF_WU_THRESHOLD_MASK               0x7F
+
+/* Click thresholds are 4-bit values in steps of 0.5 g, at about 18 mg
+ * per LSB of the output registers
+ */
+#define     CLICK_THRESHOLD_STEP_LSB             28
+#define     CLICK_TIME_LIMIT_STEP_US            500
+#define     CLICK_LATENCY_STEP_US              1000
+#define     CLICK_WINDOW_STEP_US               1000
+
+/* Interrupt pin sources in CTRL_REG3 */
+#define     INT_SOURCE_MASK                    0x07
+#define     INT2_SOURCE_SHIFT                     3
+#define     INT_SOURCE_FF_WU_1                    1
+#define     INT_SOURCE_FF_WU_2                    2
+#define     INT_SOURCE_FF_WU_BOTH                 3
+#define     INT_SOURCE_DATA_READY                 4
+#define     INT_SOURCE_CLICK                      7
+
+/* SCL periods of a byte with its acknowledge and of a START or STOP */
+#define     BYTE_CLOCKS                           9
+#define     CONDITION_CLOCKS                      1
+#define     RECOVERY_CLOCKS                       9
+
+#define     HIGH_PASS_SHIFT                       3
+#define     FIXED_POINT_SHIFT                     4
+#define     PPM                             1000000U
+#define     NANOSECONDS_PER_SECOND    1000000000ULL
+#define     AXES_NUMBER                           3
+
+
+static const uint8_t OUTPUT_REGISTERS[AXES_NUMBER] = {REGISTER_X, REGISTER_Y, REGISTER_Z};
+static const uint8_t FF_WU_CFG[2] = {FF_WU_CFG_1, FF_WU_CFG_2};
+static const uint8_t FF_WU_SRC[2] = {FF_WU_SRC_1, FF_WU_SRC_2};
+static const uint8_t FF_WU_THS[2] = {FF_WU_THS_1, FF_WU_THS_2};
+static const uint8_t FF_WU_DURATION[2] = {FF_WU_DURATION_1, FF_WU_DURATION_2};
+static const uint8_t FF_WU_HIGH_PASS[2] = {CTRL_REG2_HP_FF_WU1, CTRL_REG2_HP_FF_WU2};
+
+
+static
+uint32_t next_random(lis35de_model_t *model) {
+    uint32_t x = model->random_state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+
+    return model->random_state = x;
+}
+
+
+static
+uint8_t happens(lis35de_model_t *model, uint32_t ppm) {
+    return ppm != 0 && next_random(model) % PPM < ppm;
+}
+
+
+static
+int32_t absolute(int32_t value) {
+    return value < 0 ? -value : value;
+}
+
+
+uint32_t lis35de_odr_hz(const lis35de_model_t *model) {
+    if (model->odr_override_hz != 0) {
+        return model->odr_override_hz;
+    }
+
+    return (model->registers[I2C_CTRL_REG1] & CTRL_REG1_DR) ? 400 : 100;
+}
+
+
+static
+uint64_t sample_period_ns(const lis35de_model_t *model) {
+    return NANOSECONDS_PER_SECOND / lis35de_odr_hz(model);
+}
+
+
+static
+uint8_t is_powered(const lis35de_model_t *model) {
+    return (model->registers[I2C_CTRL_REG1] & CTRL_REG1_POWER_UP) != 0;
+}
+
+
+void lis35de_init(lis35de_model_t *model, const int8_t (*trace)[3], size_t trace_length) {
+    uint32_t odr_override_hz = model->odr_override_hz;
+
+    memset(model, 0, sizeof(*model));
+
+    model->odr_override_hz = odr_override_hz;
+    model->registers[LIS35DE_WHO_AM_I] = LIS35DE_MODEL_WHO_AM_I_VALUE;
+    model->registers[I2C_CTRL_REG1] = CTRL_REG1_POWER_ON_VALUE;
+
+    model->trace = trace;
+    model->trace_length = trace_length;
+    model->random_state = 1;
+}
+
+
+void lis35de_set_faults(lis35de_model_t *model, const lis35de_faults_t *faults) {
+    model->faults = *faults;
+    model->random_state = faults->seed != 0 ? faults->seed : 1;
+}
+
+
+/* Sets the source register of an engine: a latched source keeps its
+ * events until it is read, an unlatched one follows every sample
+ */
+static
+void update_source(lis35de_model_t *model, uint8_t source_register, uint8_t latched, uint8_t events) {
+    if (latched) {
+        if (events != 0) {
+            model->registers[source_register] |= SOURCE_IA | events;
+        }
+    } else {
+        model->registers[source_register] = events != 0 ? SOURCE_IA | events : 0;
+    }
+}
+
+
+static
+void run_ff_wu_engine(lis35de_model_t *model, int engine, const int8_t *values) {
+    lis35de_ff_wu_t *state = &model->ff_wu[engine];
+    uint8_t config = model->registers[FF_WU_CFG[engine]];
+    uint8_t enabled = config & FF_WU_EVENTS_MASK;
+    int32_t threshold = model->registers[FF_WU_THS[engine]] & FF_WU_THRESHOLD_MASK;
+    uint8_t high_pass = model->registers[I2C_CTRL_REG2] & FF_WU_HIGH_PASS[engine];
+    uint8_t occurred = 0;
+
+    for (int axis = 0; axis < AXES_NUMBER; ++axis) {
+        int32_t value = values[axis];
+        int32_t scaled = value * (1 << FIXED_POINT_SHIFT);
+
+        if (high_pass) {
+            int32_t difference = scaled - state->low_pass[axis];
+
+            state->low_pass[axis] += difference / (1 << HIGH_PASS_SHIFT);
+            value = difference / (1 << FIXED_POINT_SHIFT);
+        } else {
+            state->low_pass[axis] = scaled;
+        }
+
+        /* Low event in the even bit, high event in the odd bit */
+        occurred |= (absolute(value) > threshold ? 2 : 1) << (2 * axis);
+    }
+
+    if (enabled == 0) {
+        return;
+    }
+
+    uint8_t active = occurred & enabled;
+    uint8_t condition = (config & CONFIG_AOI) ? active == enabled : active != 0;
+
+    if (condition) {
+        state->held_samples++;
+    } else {
+        state->held_samples = 0;
+    }
+
+    uint8_t fired = condition && state->held_samples > model->registers[FF_WU_DURATION[engine]];
+
+    update_source(model, FF_WU_SRC[engine], config & CONFIG_LIR, fired ? active : 0);
+}
+
+
+static
+void run_click_engine(lis35de_model_t *model, const int8_t *values) {
+    uint8_t config = model->registers[CLICK_CFG];
+    uint8_t thresholds_y_x = model->registers[CLICK_THSY_X];
+    uint32_t thresholds[AXES_NUMBER] = {
+            thresholds_y_x & 0x0F,
+            thresholds_y_x >> 4,
+            model->registers[CLICK_THSZ] & 0x0F
+    };
+    uint64_t period_us = 1000000ULL / lis35de_odr_hz(model);
+    uint64_t time_limit_us = model->registers[CLICK_TIME_LIMIT] * CLICK_TIME_LIMIT_STEP_US;
+    uint64_t latency_us = model->registers[CLICK_LATENCY] * CLICK_LATENCY_STEP_US;
+    uint64_t window_us = model->registers[CLICK_WINDOW] * CLICK_WINDOW_STEP_US;
+    uint8_t events = 0;
+
+    for (int axis = 0; axis < AXES_NUMBER; ++axis) {
+        lis35de_click_axis_t *state = &model->click[axis];
+        uint8_t single_bit = 1 << (2 * axis);
+        uint8_t double_bit = single_bit << 1;
+
+        if (!(config & (single_bit | double_bit)) || thresholds[axis] == 0) {
+            continue;
+        }
+
+        if (state->has_clicked && ++state->samples_since_click * period_us > latency_us + window_us) {
+            state->has_clicked = 0;
+        }
+
+        if (absolute(values[axis]) > (int32_t) (thresholds[axis] * CLICK_THRESHOLD_STEP_LSB)) {
+            state->samples_above++;
+            continue;
+        }
+
+        if (state->samples_above == 0) {
+            continue;
+        }
+
+        /* A pulse counts as a click when it falls back within the limit */
+        if (state->samples_above * period_us <= time_limit_us) {
+            uint64_t since_us = state->samples_since_click * period_us;
+
+            if (state->has_clicked && since_us >= latency_us && (config & double_bit)) {
+                events |= double_bit;
+                state->has_clicked = 0;
+            } else {
+                events |= config & single_bit;
+                state->has_clicked = 1;
+                state->samples_since_click = 0;
+            }
+        }
+
+        state->samples_above = 0;
+    }
+
+    update_source(model, CLICK_SRC, config & CONFIG_LIR, events);
+}
+
+
+static
+void load_sample(lis35de_model_t *model) {
+    int8_t values[AXES_NUMBER] = {0, 0, 0};
+    uint8_t axes_enabled = model->registers[I2C_CTRL_REG1] & CTRL_REG1_AXES_ENABLE;
+
+    if (model->trace_length > 0) {
+        for (int axis = 0; axis < AXES_NUMBER; ++axis) {
+            if (axes_enabled & (1 << axis)) {
+                values[axis] = model->trace[model->trace_position][axis];
+            }
+        }
+
+        model->trace_position = (model->trace_position + 1) % model->trace_length;
+    }
+
+    for (int axis = 0; axis < AXES_NUMBER; ++axis) {
+        model->registers[OUTPUT_REGISTERS[axis]] = (uint8_t) values[axis];
+    }
+
+    uint8_t *status = &model->registers[LIS35DE_STATUS_REG];
+
+    if (*status & LIS35DE_STATUS_ZYXDA) {
+        *status |= LIS35DE_STATUS_ZYXOR | (STATUS_AXES_DATA_AVAILABLE << 4);
+        model->stats.overruns++;
+    }
+
+    *status |= LIS35DE_STATUS_ZYXDA | STATUS_AXES_DATA_AVAILABLE;
+
+    run_ff_wu_engine(model, 0, values);
+    run_ff_wu_engine(model, 1, values);
+    run_click_engine(model, values);
+
+    model->stats.samples_loaded++;
+}
+
+
+void lis35de_advance(lis35de_model_t *model, uint64_t nanoseconds) {
+    model->now_ns += nanoseconds;
+
+    if (!is_powered(model)) {
+        model->next_sample_ns = model->now_ns + sample_period_ns(model);
+        return;
+    }
+
+    while (model->next_sample_ns <= model->now_ns) {
+        load_sample(model);
+        model->next_sample_ns += sample_period_ns(model);
+    }
+}
+
+
+static
+uint8_t interrupt_level(const lis35de_model_t *model, uint8_t source) {
+    uint8_t ff_wu_1 = (model->registers[FF_WU_SRC_1] & SOURCE_IA) != 0;
+    uint8_t ff_wu_2 = (model->registers[FF_WU_SRC_2] & SOURCE_IA) != 0;
+
+    switch (source) {
+        case INT_SOURCE_FF_WU_1:
+            return ff_wu_1;
+        case INT_SOURCE_FF_WU_2:
+            return ff_wu_2;
+        case INT_SOURCE_FF_WU_BOTH:
+            return ff_wu_1 || ff_wu_2;
+        case INT_SOURCE_DATA_READY:
+            return (model->registers[LIS35DE_STATUS_REG] & LIS35DE_STATUS_ZYXDA) != 0;
+        case INT_SOURCE_CLICK:
+            return (model->registers[CLICK_SRC] & SOURCE_IA) != 0;
+        default:
+            return 0;
+    }
+}
+
+
+uint8_t lis35de_int1(const lis35de_model_t *model) {
+    return interrupt_level(model, model->registers[I2C_CTRL_REG3] & INT_SOURCE_MASK);
+}
+
+
+uint8_t lis35de_int2(const lis35de_model_t *model) {
+    return interrupt_level(model, (model->registers[I2C_CTRL_REG3] >> INT2_SOURCE_SHIFT) & INT_SOURCE_MASK);
+}
+
+
+/* Register read with the side effects of the real device */
+static
+uint8_t read_register(lis35de_model_t *model, uint8_t address) {
+    uint8_t value = model->registers[address];
+    uint8_t *status = &model->registers[LIS35DE_STATUS_REG];
+
+    for (int axis = 0; axis < AXES_NUMBER; ++axis) {
+        if (address == OUTPUT_REGISTERS[axis]) {
+            *status &= ~((1 << axis) | (1 << (axis + 4)));
+
+            /* ZYXDA and ZYXOR stay set until all three axes are read */
+            if (!(*status & STATUS_AXES_DATA_AVAILABLE)) {
+                *status &= ~(LIS35DE_STATUS_ZYXDA | LIS35DE_STATUS_ZYXOR);
+            }
+        }
+    }
+
+    if (address == FF_WU_SRC_1 || address == FF_WU_SRC_2 || address == CLICK_SRC) {
+        model->registers[address] = 0;
+    } else if (address == LIS35DE_HP_FILTER_RESET) {
+        for (int engine = 0; engine < 2; ++engine) {
+            for (int axis = 0; axis < AXES_NUMBER; ++axis) {
+                model->ff_wu[engine].low_pass[axis] =
+                        (int8_t) model->registers[OUTPUT_REGISTERS[axis]] * (1 << FIXED_POINT_SHIFT);
+            }
+        }
+    }
+
+    return value;
+}
+
+
+static
+uint8_t is_writable(uint8_t address) {
+    return (address >= I2C_CTRL_REG1 && address <= I2C_CTRL_REG3) ||
+           address == FF_WU_CFG_1 || address == FF_WU_THS_1 || address == FF_WU_DURATION_1 ||
+           address == FF_WU_CFG_2 || address == FF_WU_THS_2 || address == FF_WU_DURATION_2 ||
+           address == CLICK_CFG || (address >= CLICK_THSY_X && address <= CLICK_WINDOW);
+}
+
+
+static
+void write_register(lis35de_model_t *model, uint8_t address, uint8_t value) {
+    if (!is_writable(address)) {
+        return;
+    }
+
+    if (address == I2C_CTRL_REG1 && !is_powered(model) && (value & CTRL_REG1_POWER_UP)) {
+        model->registers[address] = value;
+        model->next_sample_ns = model->now_ns + sample_period_ns(model);
+        return;
+    }
+
+    model->registers[address] = value;
+}
+
+
+static
+void next_address(lis35de_model_t *model) {
+    if (model->auto_increment) {
+        model->address_pointer = (model->address_pointer + 1) % LIS35DE_MODEL_REGISTERS_NUMBER;
+    }
+}
+
+
+/* Counts the SCL periods of a byte, with the slave possibly holding SCL
+ * low before releasing it
+ */
+static
+void clock_byte(lis35de_model_t *model) {
+    model->stats.bus_clocks += BYTE_CLOCKS;
+
+    if (happens(model, model->faults.stretch_ppm)) {
+        model->stats.stretched_clocks += model->faults.stretch_clocks;
+        model->stats.bus_clocks += model->faults.stretch_clocks;
+    }
+}
+
+
+i2c_result_t lis35de_i2c_start(lis35de_model_t *model, uint8_t address_byte) {
+    if (model->bus_state == MODEL_BUS_STUCK) {
+        return I2C_STUCK;
+    }
+
+    model->stats.bus_clocks += CONDITION_CLOCKS;
+    clock_byte(model);
+
+    if ((address_byte >> 1) != LIS35DE_MODEL_ADDRESS || happens(model, model->faults.nack_ppm)) {
+        model->bus_state = MODEL_BUS_IGNORED;
+        model->stats.nacks++;
+        return I2C_NACK;
+    }
+
+    model->bus_state = (address_byte & 1) ? MODEL_BUS_READ : MODEL_BUS_WRITE_ADDRESS;
+
+    return I2C_ACK;
+}
+
+
+i2c_result_t lis35de_i2c_write(lis35de_model_t *model, uint8_t byte) {
+    if (model->bus_state == MODEL_BUS_STUCK) {
+        return I2C_STUCK;
+    }
+
+    clock_byte(model);
+
+    if (model->bus_state == MODEL_BUS_WRITE_ADDRESS) {
+        model->address_pointer = byte & ~I2C_AUTO_INCREMENT & (LIS35DE_MODEL_REGISTERS_NUMBER - 1);
+        model->auto_increment = (byte & I2C_AUTO_INCREMENT) != 0;
+        model->bus_state = MODEL_BUS_WRITE_DATA;
+        return I2C_ACK;
+    }
+
+    if (model->bus_state == MODEL_BUS_WRITE_DATA) {
+        write_register(model, model->address_pointer, byte);
+        next_address(model);
+        return I2C_ACK;
+    }
+
+    model->stats.nacks++;
+
+    return I2C_NACK;
+}
+
+
+i2c_result_t lis35de_i2c_read(lis35de_model_t *model, uint8_t *byte, uint8_t acknowledge) {
+    if (model->bus_state == MODEL_BUS_STUCK) {
+        return I2C_STUCK;
+    }
+
+    clock_byte(model);
+
+    if (model->bus_state != MODEL_BUS_READ) {
+        /* Nobody drives SDA, the master reads the pull-up */
+        *byte = 0xFF;
+        return I2C_NACK;
+    }
+
+    *byte = read_register(model, model->address_pointer);
+    next_address(model);
+
+    if (happens(model, model->faults.stuck_ppm)) {
+        /* The slave keeps SDA low after a bit of the next byte */
+        model->bus_state = MODEL_BUS_STUCK;
+        model->stats.stuck_events++;
+        return I2C_STUCK;
+    }
+
+    if (!acknowledge) {
+        model->bus_state = MODEL_BUS_IGNORED;
+    }
+
+    return I2C_ACK;
+}
+
+
+void lis35de_i2c_stop(lis35de_model_t *model) {
+    if (model->bus_state != MODEL_BUS_STUCK) {
+        model->bus_state = MODEL_BUS_IDLE;
+        model->stats.bus_clocks += CONDITION_CLOCKS;
+    }
+}
+
+
+void lis35de_bus_recover(lis35de_model_t *model) {
+    model->stats.bus_clocks += RECOVERY_CLOCKS + CONDITION_CLOCKS;
+    model->bus_state = MODEL_BUS_IDLE;
+}
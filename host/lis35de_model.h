@@ -0,0 +1,149 @@
+#ifndef LIS35DE_MODEL_H
+#define LIS35DE_MODEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/* Software model of the LIS35DE accelerometer as an I2C slave, driven
+ * byte by byte by a bus master the same way the I2C1 peripheral drives
+ * the real sensor. Acceleration comes from a trace replayed at the output
+ * data rate; the free-fall/wake-up and click engines evaluate the
+ * replayed samples against their registers and drive INT1 and INT2 as
+ * routed by CTRL_REG3. Faults (NACKs, clock stretching, a stuck bus) are
+ * injected with configurable probabilities.
+ */
+
+
+#define LIS35DE_MODEL_ADDRESS                    0x1C
+#define LIS35DE_MODEL_WHO_AM_I_VALUE             0x3B
+#define LIS35DE_MODEL_REGISTERS_NUMBER             64
+
+
+/* Registers the model implements beyond those in final/consts.h */
+#define LIS35DE_WHO_AM_I                         0x0F
+#define LIS35DE_HP_FILTER_RESET                  0x23
+#define LIS35DE_STATUS_REG                       0x27
+
+
+/* Bits of STATUS_REG */
+#define LIS35DE_STATUS_ZYXDA                     0x08
+#define LIS35DE_STATUS_ZYXOR                     0x80
+
+
+/* Outcome of a bus primitive */
+typedef enum {
+    I2C_ACK,
+    I2C_NACK,
+    I2C_STUCK
+} i2c_result_t;
+
+
+/* Fault probabilities in parts per million of bytes on the bus */
+typedef struct {
+    uint32_t nack_ppm;
+    uint32_t stretch_ppm;
+    uint32_t stretch_clocks;
+    uint32_t stuck_ppm;
+    uint32_t seed;
+} lis35de_faults_t;
+
+
+typedef struct {
+    uint64_t samples_loaded;
+    uint64_t overruns;
+    uint64_t nacks;
+    uint64_t stretched_clocks;
+    uint64_t stuck_events;
+    uint64_t bus_clocks;
+} lis35de_model_stats_t;
+
+
+/* State of one free-fall/wake-up engine */
+typedef struct {
+    uint32_t held_samples;
+    int32_t low_pass[3];
+} lis35de_ff_wu_t;
+
+
+/* State of the click engine for one axis */
+typedef struct {
+    uint32_t samples_above;
+    uint32_t samples_since_click;
+    uint8_t has_clicked;
+} lis35de_click_axis_t;
+
+
+typedef enum {
+    MODEL_BUS_IDLE,
+    MODEL_BUS_WRITE_ADDRESS,
+    MODEL_BUS_WRITE_DATA,
+    MODEL_BUS_READ,
+    MODEL_BUS_IGNORED,
+    MODEL_BUS_STUCK
+} lis35de_bus_state_t;
+
+
+typedef struct {
+    uint8_t registers[LIS35DE_MODEL_REGISTERS_NUMBER];
+
+    lis35de_bus_state_t bus_state;
+    uint8_t address_pointer;
+    uint8_t auto_increment;
+
+    const int8_t (*trace)[3];
+    size_t trace_length;
+    size_t trace_position;
+
+    /* Rate the trace is replayed at, 0 to follow the DR bit of CTRL_REG1 */
+    uint32_t odr_override_hz;
+    uint64_t now_ns;
+    uint64_t next_sample_ns;
+
+    lis35de_ff_wu_t ff_wu[2];
+    lis35de_click_axis_t click[3];
+
+    lis35de_faults_t faults;
+    uint32_t random_state;
+
+    lis35de_model_stats_t stats;
+} lis35de_model_t;
+
+
+/* Resets the registers to their power-on values and starts the trace,
+ * which is replayed in a loop
+ */
+void lis35de_init(lis35de_model_t *, const int8_t (*)[3], size_t);
+
+
+void lis35de_set_faults(lis35de_model_t *, const lis35de_faults_t *);
+
+
+/* Output data rate currently in effect, in Hz */
+uint32_t lis35de_odr_hz(const lis35de_model_t *);
+
+
+/* Moves the model time forward, loading every sample due meanwhile */
+void lis35de_advance(lis35de_model_t *, uint64_t);
+
+
+/* Levels of the interrupt pins */
+uint8_t lis35de_int1(const lis35de_model_t *);
+uint8_t lis35de_int2(const lis35de_model_t *);
+
+
+/* Bus primitives: a START or repeated START with the address byte, a
+ * byte written by the master, a byte read with the master's ACK or NACK,
+ * and a STOP
+ */
+i2c_result_t lis35de_i2c_start(lis35de_model_t *, uint8_t);
+i2c_result_t lis35de_i2c_write(lis35de_model_t *, uint8_t);
+i2c_result_t lis35de_i2c_read(lis35de_model_t *, uint8_t *, uint8_t);
+void lis35de_i2c_stop(lis35de_model_t *);
+
+
+/* Releases a stuck bus, as nine SCL pulses followed by a STOP do */
+void lis35de_bus_recover(lis35de_model_t *);
+
+
+#endif /* LIS35DE_MODEL_H */
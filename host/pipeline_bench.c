@@ -0,0 +1,569 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "command_parser.h"
+#include "configuration.h"
+#include "consts.h"
+#include "events.h"
+#include "messages_queue.h"
+#include "motion.h"
+#include "sample_text.h"
+
+#include "lis35de_model.h"
+
+
+#define     DEFAULT_SAMPLES_NUMBER           100000
+#define     SYNTHETIC_TRACE_LENGTH             4000
+#define     MAX_TRACE_LENGTH                1000000
+#define     I2C_SPEED_HZ                     100000
+#define     BITS_PER_FRAME                       10
+#define     ALL_AXES_READ_LENGTH  (REGISTER_Z - REGISTER_X + 1)
+#define     SOURCE_IA                          0x40
+#define     CLICK_SRC_DOUBLE_ANY               0x2A
+
+
+/* Runs the firmware sample pipeline of final/ on Linux against the
+ * LIS35DE model: the burst read of the axes over the modelled bus,
+ * motion filtering, formatting and the message queue, with the output
+ * drained at the speed of a simulated line. Reports samples/s of the
+ * host CPU together with the bus and queue counters.
+ */
+typedef struct {
+    uint32_t samples_number;
+    uint32_t odr_hz;
+    uint32_t baud_rate;
+    const char *trace_path;
+    const char *synthetic;
+    uint8_t format;
+    uint8_t axes;
+    uint8_t json;
+    lis35de_faults_t faults;
+} options_t;
+
+
+typedef struct {
+    uint64_t samples;
+    uint64_t read_failures;
+    uint64_t write_failures;
+    uint64_t bus_errors;
+    uint64_t timeouts;
+    uint64_t moving_samples;
+    uint64_t bytes_formatted;
+    uint64_t bytes_sent;
+    uint64_t free_falls;
+    uint64_t wake_ups;
+    uint64_t clicks;
+    uint64_t double_clicks;
+} bench_stats_t;
+
+
+static messages_queue_t messages_queue;
+static bench_stats_t bench_stats;
+
+
+/* Synthetic traces, values in LSB of about 18 mg with Z carrying 1 g */
+static
+void synthesize_still(int8_t (*trace)[3], size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        trace[i][0] = (int8_t) (i % 7 == 0);
+        trace[i][1] = (int8_t) -(i % 11 == 0);
+        trace[i][2] = 56;
+    }
+}
+
+
+static
+void synthesize_sine(int8_t (*trace)[3], size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        trace[i][0] = (int8_t) (60.0 * sin(2.0 * M_PI * i / 397.0));
+        trace[i][1] = (int8_t) (40.0 * sin(2.0 * M_PI * i / 251.0 + 1.0));
+        trace[i][2] = (int8_t) (56.0 + 20.0 * sin(2.0 * M_PI * i / 163.0));
+    }
+}
+
+
+/* Still trace with a short spike on X every second at 400 Hz, every other
+ * pair close enough to make a double click
+ */
+static
+void synthesize_taps(int8_t (*trace)[3], size_t length) {
+    synthesize_still(trace, length);
+
+    for (size_t i = 0; i < length; ++i) {
+        size_t phase = i % 400;
+
+        if (phase == 100 || phase == 101 || ((i / 400) % 2 == 1 && (phase == 140 || phase == 141))) {
+            trace[i][0] = 110;
+        }
+    }
+}
+
+
+/* Still trace with 200 ms of free fall (all axes near 0 g) every 2 s */
+static
+void synthesize_free_fall(int8_t (*trace)[3], size_t length) {
+    synthesize_still(trace, length);
+
+    for (size_t i = 0; i < length; ++i) {
+        if (i % 800 >= 400 && i % 800 < 480) {
+            trace[i][0] = trace[i][1] = trace[i][2] = 0;
+        }
+    }
+}
+
+
+/* Reads "x y z" lines of signed values, blank lines are skipped. Returns
+ * 0 when the file cannot be read or a line is not a sample.
+ */
+static
+size_t load_trace(const char *path, int8_t (*trace)[3], size_t capacity) {
+    FILE *file = fopen(path, "r");
+    char line[128];
+    size_t length = 0;
+    size_t line_number = 0;
+    int x, y, z;
+    char rest;
+
+    if (file == NULL) {
+        fprintf(stderr, "pipeline_bench: cannot open %s: %s\n", path, strerror(errno));
+        return 0;
+    }
+
+    while (length < capacity && fgets(line, sizeof(line), file) != NULL) {
+        line_number++;
+
+        if (strspn(line, " \t\r\n") == strlen(line)) {
+            continue;
+        }
+
+        if (sscanf(line, "%d %d %d %c", &x, &y, &z, &rest) != 3 ||
+            x < INT8_MIN || x > INT8_MAX || y < INT8_MIN || y > INT8_MAX ||
+            z < INT8_MIN || z > INT8_MAX) {
+            fprintf(stderr, "pipeline_bench: %s:%zu: not an \"x y z\" sample\n", path, line_number);
+            fclose(file);
+            return 0;
+        }
+
+        trace[length][0] = (int8_t) x;
+        trace[length][1] = (int8_t) y;
+        trace[length][2] = (int8_t) z;
+        length++;
+    }
+
+    fclose(file);
+
+    if (length == 0) {
+        fprintf(stderr, "pipeline_bench: %s: no samples\n", path);
+    }
+
+    return length;
+}
+
+
+/* Transaction shapes of final/i2c.c, one attempt each as the firmware
+ * makes them: a NACK ends the transaction from the error interrupt, a
+ * stuck bus runs into the transaction timeout and stays stuck since
+ * neither path recovers it
+ */
+static
+i2c_result_t try_read(lis35de_model_t *model, uint8_t register_number, uint8_t *values, uint32_t length) {
+    i2c_result_t result;
+
+    if ((result = lis35de_i2c_start(model, LIS35DE_ADDR << 1)) != I2C_ACK ||
+        (result = lis35de_i2c_write(model, register_number)) != I2C_ACK ||
+        (result = lis35de_i2c_start(model, LIS35DE_ADDR << 1 | 1)) != I2C_ACK) {
+        return result;
+    }
+
+    for (uint32_t i = 0; i < length; ++i) {
+        if ((result = lis35de_i2c_read(model, &values[i], i + 1 < length)) != I2C_ACK) {
+            return result;
+        }
+    }
+
+    return I2C_ACK;
+}
+
+
+static
+i2c_result_t try_write(lis35de_model_t *model, uint8_t register_number, uint8_t value) {
+    i2c_result_t result;
+
+    if ((result = lis35de_i2c_start(model, LIS35DE_ADDR << 1)) != I2C_ACK ||
+        (result = lis35de_i2c_write(model, register_number)) != I2C_ACK) {
+        return result;
+    }
+
+    return lis35de_i2c_write(model, value);
+}
+
+
+static
+uint8_t finish_transaction(lis35de_model_t *model, i2c_result_t result) {
+    lis35de_i2c_stop(model);
+
+    if (result == I2C_NACK) {
+        bench_stats.bus_errors++;
+    } else if (result == I2C_STUCK) {
+        bench_stats.timeouts++;
+    }
+
+    return result == I2C_ACK;
+}
+
+
+static
+uint8_t read_registers(lis35de_model_t *model, uint8_t register_number, uint8_t *values, uint32_t length) {
+    uint8_t sub_address = register_number | (length > 1 ? I2C_AUTO_INCREMENT : 0);
+
+    if (finish_transaction(model, try_read(model, sub_address, values, length))) {
+        return 1;
+    }
+
+    bench_stats.read_failures++;
+
+    return 0;
+}
+
+
+static
+void write_register(lis35de_model_t *model, uint8_t register_number, uint8_t value) {
+    if (!finish_transaction(model, try_write(model, register_number, value))) {
+        bench_stats.write_failures++;
+    }
+}
+
+
+/* Same register values as I2C_configure() and events_configure() */
+static
+void configure_sensor(lis35de_model_t *model) {
+    static const uint8_t CONFIGURATION[][2] = {
+            {I2C_CTRL_REG1,    CTRL_REG1_VALUE},
+            {I2C_CTRL_REG3,    CTRL_REG3_VALUE},
+            {FF_WU_CFG_1,      FF_WU_CFG_1_VALUE},
+            {FF_WU_THS_1,      FF_WU_THS_1_VALUE},
+            {FF_WU_DURATION_1, FF_WU_DURATION_1_VALUE},
+            {FF_WU_CFG_2,      FF_WU_CFG_2_VALUE},
+            {FF_WU_THS_2,      FF_WU_THS_2_VALUE},
+            {FF_WU_DURATION_2, FF_WU_DURATION_2_VALUE},
+            {I2C_CTRL_REG2,    CTRL_REG2_VALUE},
+            {CLICK_CFG,        CLICK_CFG_VALUE},
+            {CLICK_THSY_X,     CLICK_THSY_X_VALUE},
+            {CLICK_THSZ,       CLICK_THSZ_VALUE},
+            {CLICK_TIME_LIMIT, CLICK_TIME_LIMIT_VALUE},
+            {CLICK_LATENCY,    CLICK_LATENCY_VALUE},
+            {CLICK_WINDOW,     CLICK_WINDOW_VALUE}
+    };
+
+    for (size_t i = 0; i < sizeof(CONFIGURATION) / sizeof(CONFIGURATION[0]); ++i) {
+        write_register(model, CONFIGURATION[i][0], CONFIGURATION[i][1]);
+    }
+}
+
+
+/* What the EXTI handlers of final/events.c do on a rising edge of INT1
+ * and INT2
+ */
+static
+void service_interrupts(lis35de_model_t *model) {
+    static uint8_t int1_level, int2_level;
+    uint8_t source;
+
+    if (lis35de_int1(model) && !int1_level) {
+        if (read_registers(model, FF_WU_SRC_1, &source, 1) && (source & SOURCE_IA)) {
+            bench_stats.free_falls++;
+        }
+
+        if (read_registers(model, FF_WU_SRC_2, &source, 1) && (source & SOURCE_IA)) {
+            bench_stats.wake_ups++;
+        }
+    }
+
+    if (lis35de_int2(model) && !int2_level &&
+        read_registers(model, CLICK_SRC, &source, 1) && (source & SOURCE_IA)) {
+        if (source & CLICK_SRC_DOUBLE_ANY) {
+            bench_stats.double_clicks++;
+        } else {
+            bench_stats.clicks++;
+        }
+    }
+
+    int1_level = lis35de_int1(model);
+    int2_level = lis35de_int2(model);
+}
+
+
+/* Sends queued messages while the simulated line has time left */
+static
+void drain_queue(double *line_budget_bytes) {
+    while (!is_queue_empty(&messages_queue)) {
+        const char *message = messages_queue.messages[messages_queue.read_position];
+        uint32_t length = strlen(message);
+
+        if (*line_budget_bytes < length) {
+            return;
+        }
+
+        *line_budget_bytes -= length;
+        bench_stats.bytes_sent += length;
+        poll_queue(&messages_queue);
+    }
+}
+
+
+static
+void process_sample(const uint8_t *burst, const options_t *options) {
+    uint8_t values[SAMPLE_AXES_NUMBER];
+    char text[SAMPLE_TEXT_MAX_LENGTH + 1];
+
+    for (int axis = 0; axis < SAMPLE_AXES_NUMBER; ++axis) {
+        values[axis] = burst[axis * (REGISTER_Y - REGISTER_X)];
+    }
+
+    if (motion_update((int8_t) values[0], (int8_t) values[1], (int8_t) values[2]) ||
+        !motion_is_still()) {
+        bench_stats.moving_samples++;
+    }
+
+    uint32_t length = format_sample(text, values, options->axes, options->format);
+
+    text[length] = '\0';
+    bench_stats.bytes_formatted += length;
+
+    offer_sample(&messages_queue, text);
+}
+
+
+static
+double seconds_between(const struct timespec *start, const struct timespec *end) {
+    return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+
+static
+void print_report(const lis35de_model_t *model, const options_t *options, double elapsed) {
+    const lis35de_model_stats_t *model_stats = &model->stats;
+    double bus_seconds = (double) model_stats->bus_clocks / I2C_SPEED_HZ;
+    double sampled_seconds = (double) bench_stats.samples / lis35de_odr_hz(model);
+    double rate = elapsed > 0 ? bench_stats.samples / elapsed : 0.0;
+
+    if (options->json) {
+        printf("{\"samples\":%llu,\"elapsed_s\":%.3f,\"samples_per_s\":%.0f,\"odr_hz\":%u,"
+               "\"bus_utilization\":%.3f,\"read_failures\":%llu,\"write_failures\":%llu,"
+               "\"bus_errors\":%llu,\"timeouts\":%llu,\"nacks\":%llu,\"stretched_clocks\":%llu,\"overruns\":%llu,"
+               "\"moving_samples\":%llu,\"bytes_formatted\":%llu,\"bytes_sent\":%llu,"
+               "\"queue_dropped\":%u,\"queue_high_water\":%u,\"free_falls\":%llu,"
+               "\"wake_ups\":%llu,\"clicks\":%llu,\"double_clicks\":%llu}\n",
+               (unsigned long long) bench_stats.samples, elapsed, rate, lis35de_odr_hz(model),
+               sampled_seconds > 0 ? bus_seconds / sampled_seconds : 0.0,
+               (unsigned long long) bench_stats.read_failures,
+               (unsigned long long) bench_stats.write_failures,
+               (unsigned long long) bench_stats.bus_errors,
+               (unsigned long long) bench_stats.timeouts,
+               (unsigned long long) model_stats->nacks,
+               (unsigned long long) model_stats->stretched_clocks,
+               (unsigned long long) model_stats->overruns,
+               (unsigned long long) bench_stats.moving_samples,
+               (unsigned long long) bench_stats.bytes_formatted,
+               (unsigned long long) bench_stats.bytes_sent,
+               messages_queue.stats.dropped, messages_queue.stats.high_water,
+               (unsigned long long) bench_stats.free_falls,
+               (unsigned long long) bench_stats.wake_ups,
+               (unsigned long long) bench_stats.clicks,
+               (unsigned long long) bench_stats.double_clicks);
+        return;
+    }
+
+    printf("samples       %llu in %.3f s, %.0f samples/s (ODR %u Hz)\n",
+           (unsigned long long) bench_stats.samples, elapsed, rate, lis35de_odr_hz(model));
+    printf("bus           %.1f%% of the I2C time at %u Hz, %llu NACKs, %llu stretched clocks\n",
+           sampled_seconds > 0 ? 100.0 * bus_seconds / sampled_seconds : 0.0, I2C_SPEED_HZ,
+           (unsigned long long) model_stats->nacks, (unsigned long long) model_stats->stretched_clocks);
+    printf("transfers     %llu reads and %llu writes failed, %llu bus errors, %llu timeouts, %llu overruns\n",
+           (unsigned long long) bench_stats.read_failures, (unsigned long long) bench_stats.write_failures,
+           (unsigned long long) bench_stats.bus_errors, (unsigned long long) bench_stats.timeouts,
+           (unsigned long long) model_stats->overruns);
+    printf("pipeline      %llu moving samples, %llu bytes formatted, %llu sent, "
+           "queue dropped %u high water %u\n",
+           (unsigned long long) bench_stats.moving_samples,
+           (unsigned long long) bench_stats.bytes_formatted,
+           (unsigned long long) bench_stats.bytes_sent,
+           messages_queue.stats.dropped, messages_queue.stats.high_water);
+    printf("interrupts    %llu free-fall, %llu wake-up, %llu click, %llu double click\n",
+           (unsigned long long) bench_stats.free_falls, (unsigned long long) bench_stats.wake_ups,
+           (unsigned long long) bench_stats.clicks, (unsigned long long) bench_stats.double_clicks);
+}
+
+
+static
+void usage(const char *program) {
+    fprintf(stderr,
+            "usage: %s [-n samples] [-o odr_hz] [-b baud] [-s still|sine|taps|freefall] "
+            "[-f trace] [-x] [-a axes] [-N ppm] [-S ppm] [-C clocks] [-K ppm] [-r seed] [-j]\n"
+            "  -n  number of samples to run (default %u)\n"
+            "  -o  replay the trace at this rate instead of the ODR set in CTRL_REG1\n"
+            "  -b  drain the queue at the speed of this line (default unlimited)\n"
+            "  -s  synthetic trace (default sine)\n"
+            "  -f  trace file of \"x y z\" lines\n"
+            "  -x  hexadecimal sample format\n"
+            "  -a  reported axes, e.g. XYZ (default XY)\n"
+            "  -N  address NACKs per million bytes\n"
+            "  -S  clock stretches per million bytes, -C clocks each (default 9)\n"
+            "  -K  stuck bus events per million bytes read\n"
+            "  -r  seed of the fault injection\n"
+            "  -j  print a JSON line\n",
+            program, DEFAULT_SAMPLES_NUMBER);
+}
+
+
+static
+int parse_options(int argc, char **argv, options_t *options) {
+    int opt;
+
+    memset(options, 0, sizeof(*options));
+
+    options->samples_number = DEFAULT_SAMPLES_NUMBER;
+    options->synthetic = "sine";
+    options->format = COMMAND_FORMAT_DECIMAL;
+    options->axes = COMMAND_AXIS_X | COMMAND_AXIS_Y;
+    options->faults.stretch_clocks = 9;
+
+    while ((opt = getopt(argc, argv, "n:o:b:s:f:xa:N:S:C:K:r:j")) != -1) {
+        switch (opt) {
+            case 'n':
+                options->samples_number = strtoul(optarg, NULL, 10);
+                break;
+            case 'o':
+                options->odr_hz = strtoul(optarg, NULL, 10);
+                break;
+            case 'b':
+                options->baud_rate = strtoul(optarg, NULL, 10);
+                break;
+            case 's':
+                options->synthetic = optarg;
+                break;
+            case 'f':
+                options->trace_path = optarg;
+                break;
+            case 'x':
+                options->format = COMMAND_FORMAT_HEXADECIMAL;
+                break;
+            case 'a':
+                options->axes = 0;
+
+                for (const char *axis = optarg; *axis != '\0'; ++axis) {
+                    if (*axis < 'X' || *axis > 'Z') {
+                        return -1;
+                    }
+
+                    options->axes |= COMMAND_AXIS_X << (*axis - 'X');
+                }
+                break;
+            case 'N':
+                options->faults.nack_ppm = strtoul(optarg, NULL, 10);
+                break;
+            case 'S':
+                options->faults.stretch_ppm = strtoul(optarg, NULL, 10);
+                break;
+            case 'C':
+                options->faults.stretch_clocks = strtoul(optarg, NULL, 10);
+                break;
+            case 'K':
+                options->faults.stuck_ppm = strtoul(optarg, NULL, 10);
+                break;
+            case 'r':
+                options->faults.seed = strtoul(optarg, NULL, 10);
+                break;
+            case 'j':
+                options->json = 1;
+                break;
+            default:
+                return -1;
+        }
+    }
+
+    return optind == argc && options->axes != 0 ? 0 : -1;
+}
+
+
+int main(int argc, char **argv) {
+    options_t options;
+
+    if (parse_options(argc, argv, &options) != 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    static int8_t trace[MAX_TRACE_LENGTH][3];
+    size_t trace_length = SYNTHETIC_TRACE_LENGTH;
+
+    if (options.trace_path != NULL) {
+        trace_length = load_trace(options.trace_path, trace, MAX_TRACE_LENGTH);
+    } else if (strcmp(options.synthetic, "still") == 0) {
+        synthesize_still(trace, trace_length);
+    } else if (strcmp(options.synthetic, "sine") == 0) {
+        synthesize_sine(trace, trace_length);
+    } else if (strcmp(options.synthetic, "taps") == 0) {
+        synthesize_taps(trace, trace_length);
+    } else if (strcmp(options.synthetic, "freefall") == 0) {
+        synthesize_free_fall(trace, trace_length);
+    } else {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (trace_length == 0) {
+        return 1;
+    }
+
+    static lis35de_model_t model;
+
+    model.odr_override_hz = options.odr_hz;
+    lis35de_init(&model, (const int8_t (*)[3]) trace, trace_length);
+    lis35de_set_faults(&model, &options.faults);
+
+    clear_queue(&messages_queue);
+    set_queue_policy(&messages_queue, QUEUE_POLICY_DROP_NEWEST);
+    motion_reset();
+
+    configure_sensor(&model);
+
+    double line_budget_bytes = 0;
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (uint32_t sample = 0; sample < options.samples_number; ++sample) {
+        uint8_t burst[ALL_AXES_READ_LENGTH];
+        uint32_t odr_hz = lis35de_odr_hz(&model);
+
+        lis35de_advance(&model, 1000000000ULL / odr_hz);
+
+        if (read_registers(&model, REGISTER_X, burst, ALL_AXES_READ_LENGTH)) {
+            process_sample(burst, &options);
+        }
+
+        service_interrupts(&model);
+
+        line_budget_bytes = options.baud_rate == 0
+                            ? INFINITY
+                            : line_budget_bytes + (double) options.baud_rate / BITS_PER_FRAME / odr_hz;
+        drain_queue(&line_budget_bytes);
+
+        bench_stats.samples++;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    print_report(&model, &options, seconds_between(&start, &end));
+
+    return 0;
+}
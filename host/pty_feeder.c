@@ -0,0 +1,265 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+
+#define     DEFAULT_BAUD_RATE                  9600
+#define     DEFAULT_SAMPLE_RATE_HZ               40
+#define     DEFAULT_RECORDS_NUMBER              400
+#define     BITS_PER_FRAME                       10
+#define     RECORD_BUFFER_SIZE                   32
+
+
+/* Simulated firmware feeding a pseudo-terminal with the same records that
+ * final/main.c and task2/zad2.c emit on USART2, paced both by the sample
+ * rate and by the time the bytes would need on a real line
+ */
+typedef struct {
+    const char *link_path;
+    uint32_t baud_rate;
+    uint32_t sample_rate_hz;
+    uint32_t records_number;
+    uint32_t button_every;
+    uint32_t corrupt_every;
+    uint32_t start_delay_ms;
+} options_t;
+
+
+static const char *BUTTON_MESSAGES[] = {
+        "USER PRESSED\r\n",
+        "USER RELEASED\r\n",
+        "FIRE PRESSED\r\n",
+        "FIRE RELEASED\r\n"
+};
+
+
+static
+void sleep_until(struct timespec *deadline) {
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, deadline, NULL) == EINTR) {}
+}
+
+
+static
+void advance(struct timespec *ts, double seconds) {
+    long long nanoseconds = ts->tv_nsec + (long long) (seconds * 1e9);
+
+    ts->tv_sec += nanoseconds / 1000000000LL;
+    ts->tv_nsec = nanoseconds % 1000000000LL;
+}
+
+
+static
+uint8_t synthetic_axis(uint32_t sample, double period, double phase) {
+    return (uint8_t) (128.0 + 100.0 * sin(2.0 * M_PI * sample / period + phase));
+}
+
+
+static
+int format_record(char *record, uint32_t sample, const options_t *options) {
+    if (options->button_every != 0 && sample % options->button_every == options->button_every - 1) {
+        const char *message = BUTTON_MESSAGES[(sample / options->button_every) % 4];
+        return snprintf(record, RECORD_BUFFER_SIZE, "%s", message);
+    }
+
+    if (options->corrupt_every != 0 && sample % options->corrupt_every == options->corrupt_every - 1) {
+        return snprintf(record, RECORD_BUFFER_SIZE, "X1?2Y\r\n");
+    }
+
+    return snprintf(record, RECORD_BUFFER_SIZE, "X%03uY%03u\r\n",
+                    synthetic_axis(sample, 97.0, 0.0),
+                    synthetic_axis(sample, 61.0, 1.0));
+}
+
+
+static
+int write_all(int fd, const char *data, int length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return -1;
+        }
+
+        data += written;
+        length -= written;
+    }
+
+    return 0;
+}
+
+
+static
+int open_pty(const options_t *options) {
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        perror("pty_feeder: posix_openpt");
+        return -1;
+    }
+
+    const char *slave_name = ptsname(master);
+
+    /* Switch the line discipline to raw before the receiver attaches, so
+     * that CR LF pairs reach it unchanged
+     */
+    int slave = open(slave_name, O_RDWR | O_NOCTTY);
+    struct termios tio;
+
+    if (slave >= 0 && tcgetattr(slave, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(slave, TCSANOW, &tio);
+    }
+
+    if (slave >= 0) {
+        close(slave);
+    }
+
+    if (options->link_path != NULL) {
+        unlink(options->link_path);
+
+        if (symlink(slave_name, options->link_path) != 0) {
+            perror("pty_feeder: symlink");
+            close(master);
+            return -1;
+        }
+    }
+
+    printf("%s\n", slave_name);
+    fflush(stdout);
+
+    return master;
+}
+
+
+static
+void usage(const char *program) {
+    fprintf(stderr,
+            "usage: %s [-b baud] [-r rate_hz] [-n records] [-B every] [-E every] "
+            "[-s delay_ms] [-l link]\n"
+            "  -b  simulated line speed (default %u)\n"
+            "  -r  sample rate of the simulated firmware (default %u)\n"
+            "  -n  number of records to emit (default %u)\n"
+            "  -B  emit a button message every N records\n"
+            "  -E  emit a malformed record every N records\n"
+            "  -s  wait before the first record (default 0)\n"
+            "  -l  create a symlink to the pty slave at this path\n",
+            program, DEFAULT_BAUD_RATE, DEFAULT_SAMPLE_RATE_HZ, DEFAULT_RECORDS_NUMBER);
+}
+
+
+static
+int parse_options(int argc, char **argv, options_t *options) {
+    int opt;
+
+    memset(options, 0, sizeof(*options));
+
+    options->baud_rate = DEFAULT_BAUD_RATE;
+    options->sample_rate_hz = DEFAULT_SAMPLE_RATE_HZ;
+    options->records_number = DEFAULT_RECORDS_NUMBER;
+
+    while ((opt = getopt(argc, argv, "b:r:n:B:E:s:l:")) != -1) {
+        switch (opt) {
+            case 'b':
+                options->baud_rate = strtoul(optarg, NULL, 10);
+                break;
+            case 'r':
+                options->sample_rate_hz = strtoul(optarg, NULL, 10);
+                break;
+            case 'n':
+                options->records_number = strtoul(optarg, NULL, 10);
+                break;
+            case 'B':
+                options->button_every = strtoul(optarg, NULL, 10);
+                break;
+            case 'E':
+                options->corrupt_every = strtoul(optarg, NULL, 10);
+                break;
+            case 's':
+                options->start_delay_ms = strtoul(optarg, NULL, 10);
+                break;
+            case 'l':
+                options->link_path = optarg;
+                break;
+            default:
+                return -1;
+        }
+    }
+
+    if (optind != argc || options->baud_rate == 0 || options->sample_rate_hz == 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+
+int main(int argc, char **argv) {
+    options_t options;
+
+    if (parse_options(argc, argv, &options) != 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    int master = open_pty(&options);
+
+    if (master < 0) {
+        return 1;
+    }
+
+    usleep(options.start_delay_ms * 1000);
+
+    struct timespec next_sample;
+    struct timespec line_free;
+
+    clock_gettime(CLOCK_MONOTONIC, &next_sample);
+    line_free = next_sample;
+
+    char record[RECORD_BUFFER_SIZE];
+
+    for (uint32_t sample = 0; sample < options.records_number; ++sample) {
+        int length = format_record(record, sample, &options);
+
+        /* A record cannot start before the previous one left the line */
+        if (line_free.tv_sec > next_sample.tv_sec ||
+            (line_free.tv_sec == next_sample.tv_sec && line_free.tv_nsec > next_sample.tv_nsec)) {
+            sleep_until(&line_free);
+        } else {
+            sleep_until(&next_sample);
+            line_free = next_sample;
+        }
+
+        if (write_all(master, record, length) != 0) {
+            perror("pty_feeder: write");
+            break;
+        }
+
+        advance(&line_free, (double) length * BITS_PER_FRAME / options.baud_rate);
+        advance(&next_sample, 1.0 / options.sample_rate_hz);
+    }
+
+    /* Let the receiver drain the pty before the hang-up */
+    tcdrain(master);
+    usleep(100000);
+
+    close(master);
+
+    if (options.link_path != NULL) {
+        unlink(options.link_path);
+    }
+
+    return 0;
+}
@@ -0,0 +1,189 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "messages_queue.h"
+
+
+#define     STREAM_BUFFER_SIZE   (MESSAGES_QUEUE_BUFFER_SIZE * MESSAGES_QUEUE_MESSAGE_SIZE * 2)
+#define     OVERFLOW_SAMPLES                    100
+
+
+/* Checks of final/messages_queue.c: texts longer than one message, such
+ * as the counters replies, must come out of a full queue either whole or
+ * not at all under every overflow policy
+ */
+
+
+/* Counters reply of the widest values, two messages long, and a summary
+ * record six messages long
+ */
+static const char *REPLIES[] = {
+        "QE4294967295D4294967295H512\r\n",
+        "S4096X-128,127,-127.99,16383.99Y-128,127,-127.99,16383.99Z-128,127,-127.99,16383.99\r\n"
+};
+
+
+static const char *POLICY_NAMES[] = {
+        "drop-newest", "drop-oldest", "coalesce"
+};
+
+
+static messages_queue_t queue;
+static char stream[STREAM_BUFFER_SIZE];
+static uint32_t stream_length;
+static int failures;
+
+
+static
+void offer_samples(uint32_t number) {
+    char sample[MESSAGES_QUEUE_MESSAGE_SIZE];
+
+    for (uint32_t i = 0; i < number; ++i) {
+        snprintf(sample, sizeof(sample), "X%03uY%03u\r\n", i % 1000, (i / 1000) % 1000);
+        offer_sample(&queue, sample);
+    }
+}
+
+
+static
+void append(const char *message) {
+    uint32_t length = strlen(message);
+
+    memcpy(stream + stream_length, message, length);
+    stream_length += length;
+}
+
+
+static
+void drain(void) {
+    while (!is_queue_empty(&queue)) {
+        append(poll_queue(&queue));
+    }
+}
+
+
+/* Checks that the drained bytes are whole records, samples or the reply,
+ * and returns how many times the reply arrived, -1 when anything else did
+ */
+static
+int count_replies(const char *reply) {
+    int replies = 0;
+    uint32_t reply_length = strlen(reply);
+    uint32_t position = 0;
+
+    while (position < stream_length) {
+        const char *end = memchr(stream + position, '\n', stream_length - position);
+        uint32_t length = end != NULL ? end - (stream + position) + 1 : stream_length - position;
+        unsigned x;
+        unsigned y;
+        int consumed = 0;
+
+        if (length == reply_length && memcmp(stream + position, reply, length) == 0) {
+            ++replies;
+        } else if (sscanf(stream + position, "X%3uY%3u\r\n%n", &x, &y, &consumed) != 2 ||
+                   (uint32_t) consumed != length) {
+            return -1;
+        }
+
+        position += length;
+    }
+
+    return replies;
+}
+
+
+static
+void check(const char *name, queue_policy_t policy, const char *reply, int expected) {
+    int replies = count_replies(reply);
+
+    if (replies != expected) {
+        printf("FAIL %-36s %-12s reply %d times, expected %d%s\n", name,
+               POLICY_NAMES[policy], replies < 0 ? 0 : replies, expected,
+               replies < 0 ? ", garbled record" : "");
+        ++failures;
+    } else {
+        printf("ok   %-36s %-12s\n", name, POLICY_NAMES[policy]);
+    }
+}
+
+
+static
+void reset(queue_policy_t policy) {
+    clear_queue(&queue);
+    set_queue_policy(&queue, policy);
+    reset_queue_stats(&queue);
+    stream_length = 0;
+}
+
+
+/* The reply arrives at a queue full of samples, more samples follow */
+static
+void test_reply_to_full_queue(queue_policy_t policy, const char *reply) {
+    reset(policy);
+    offer_samples(MESSAGES_QUEUE_BUFFER_SIZE);
+    offer_text(&queue, reply);
+    offer_samples(OVERFLOW_SAMPLES);
+    drain();
+
+    check("reply to a full queue", policy, reply, policy == QUEUE_POLICY_DROP_NEWEST ? 0 : 1);
+}
+
+
+/* The reply arrives with one free slot left, fewer than it needs */
+static
+void test_reply_to_almost_full_queue(queue_policy_t policy, const char *reply) {
+    reset(policy);
+    offer_samples(MESSAGES_QUEUE_BUFFER_SIZE - 1);
+    offer_text(&queue, reply);
+    offer_samples(OVERFLOW_SAMPLES);
+    drain();
+
+    check("reply to an almost full queue", policy, reply, policy == QUEUE_POLICY_DROP_NEWEST ? 0 : 1);
+}
+
+
+/* The first part of the reply is already being sent when the queue fills
+ * up, so the rest of it must stay
+ */
+static
+void test_overflow_during_reply(queue_policy_t policy, const char *reply) {
+    reset(policy);
+    offer_text(&queue, reply);
+    append(poll_queue(&queue));
+    offer_samples(MESSAGES_QUEUE_BUFFER_SIZE + OVERFLOW_SAMPLES);
+    drain();
+
+    check("overflow while the reply is sent", policy, reply, 1);
+}
+
+
+/* The reply is queued behind samples that keep overflowing the queue */
+static
+void test_reply_in_backlog(queue_policy_t policy, const char *reply) {
+    reset(policy);
+    offer_samples(MESSAGES_QUEUE_BUFFER_SIZE / 2);
+    offer_text(&queue, reply);
+    offer_samples(MESSAGES_QUEUE_BUFFER_SIZE / 2 - 1);
+    drain();
+
+    check("reply queued in the backlog", policy, reply, 1);
+}
+
+
+int main(void) {
+    for (uint32_t i = 0; i < sizeof(REPLIES) / sizeof(REPLIES[0]); ++i) {
+        printf("reply of %zu bytes\n", strlen(REPLIES[i]));
+
+        for (int policy = QUEUE_POLICY_DROP_NEWEST; policy <= QUEUE_POLICY_COALESCE; ++policy) {
+            test_reply_to_full_queue(policy, REPLIES[i]);
+            test_reply_to_almost_full_queue(policy, REPLIES[i]);
+            test_overflow_during_reply(policy, REPLIES[i]);
+            test_reply_in_backlog(policy, REPLIES[i]);
+        }
+    }
+
+    printf("%d failures\n", failures);
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,911 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+
+#define     LINE_BUFFER_SIZE                    128
+#define     READ_CHUNK_SIZE                     512
+#define     DEFAULT_BAUD_RATE                  9600
+#define     DEFAULT_REPORT_INTERVAL_MS         1000
+#define     ACCELERATION_DIGITS                   3
+#define     ACCELERATION_HEX_DIGITS               2
+#define     BITS_PER_FRAME                       10
+#define     SENSORS_MAX                          10
+
+
+/* Binary capture blocks, see final/capture.h */
+#define     BLOCK_SYNC_0                       0xA5
+#define     BLOCK_SYNC_1                       0x5A
+#define     BLOCK_HEADER_SIZE                     6
+#define     BLOCK_SAMPLE_SIZE                     8
+#define     BLOCK_MAX_SAMPLES                    64
+#define     BLOCK_MAX_SIZE     (BLOCK_HEADER_SIZE + BLOCK_MAX_SAMPLES * BLOCK_SAMPLE_SIZE + 1)
+
+
+/* Kinds of records the firmware may emit on USART2 */
+typedef enum {
+    RECORD_ACCELERATION,
+    RECORD_BUTTON,
+    RECORD_QUEUE_STATS,
+    RECORD_CAPTURE_BLOCK,
+    RECORD_MOTION_EVENT,
+    RECORD_COUNTERS,
+    RECORD_REPLY,
+    RECORD_SUMMARY,
+    RECORD_KINDS_NUMBER
+} record_kind_t;
+
+
+static const char *RECORD_KIND_NAMES[RECORD_KINDS_NUMBER] = {
+        "acceleration",
+        "button",
+        "queue_stats",
+        "capture_block",
+        "motion_event",
+        "counters",
+        "reply",
+        "summary"
+};
+
+
+/* Replies to the text commands of the firmware */
+static const char *REPLIES[] = {
+        "OK", "ERR"
+};
+
+
+static const char *BUTTON_NAMES[] = {
+        "USER", "LEFT", "RIGHT", "UP", "DOWN", "FIRE", "MODE"
+};
+
+
+static const char *BUTTON_EDGES[] = {
+        "PRESSED", "RELEASED", "PRESET"
+};
+
+
+/* Accelerometer events, as written by firmware events_next_message() */
+static const char *MOTION_EVENTS[] = {
+        "FREEFALL", "WAKEUP"
+};
+
+
+static const char *CLICK_EVENTS[] = {
+        "CLICK", "DCLICK"
+};
+
+
+/* Running statistics of inter-record gaps, updated with Welford's method
+ * so that the jitter (standard deviation of the gap) needs no sample log
+ */
+typedef struct {
+    uint64_t count;
+    double mean;
+    double m2;
+    double min;
+    double max;
+} gap_stats_t;
+
+
+/* Counters gathered over one reporting interval or the whole run.
+ * Samples carry no sequence number, so the sample shortfall is only an
+ * estimate: how many samples each sensor is behind the count its
+ * sampling period gives since its first sample, summed over the sensors.
+ * A late sample is made up by the ones arriving early after it, a lost
+ * one never is. Dropped messages are the latest count the firmware
+ * reported in its queue counters.
+ */
+typedef struct {
+    uint64_t bytes;
+    uint64_t padding_bytes;
+    uint64_t records[RECORD_KINDS_NUMBER];
+    uint64_t format_errors;
+    uint64_t overlong_lines;
+    uint64_t capture_samples;
+    uint64_t block_errors;
+    uint64_t block_sequence_gaps;
+    uint64_t sample_shortfall;
+    uint64_t shared_chunk_records;
+    uint64_t firmware_dropped;
+    gap_stats_t gaps;
+} stream_stats_t;
+
+
+typedef struct {
+    const char *device;
+    uint32_t baud_rate;
+    uint32_t sample_period_us;
+    uint32_t report_interval_ms;
+    uint32_t duration_ms;
+    int json;
+    int quiet;
+} options_t;
+
+
+static char line[LINE_BUFFER_SIZE];
+static uint32_t line_used;
+static int line_overflowed;
+
+static double last_record_time;
+static int have_last_record;
+
+/* Time of the first sample of each sensor and the samples received
+ * since, untagged samples count as sensor 0
+ */
+static double first_sample_time[SENSORS_MAX];
+static uint64_t samples_received[SENSORS_MAX];
+static uint64_t sample_shortfall[SENSORS_MAX];
+
+static uint32_t chunk_records;
+static double sample_period;
+
+static uint8_t block[BLOCK_MAX_SIZE];
+static uint32_t block_used;
+static int in_block;
+static int have_block_sequence;
+static uint16_t expected_block_sequence;
+
+static double first_byte_time;
+static double last_byte_time;
+
+static stream_stats_t interval_stats;
+static stream_stats_t total_stats;
+
+
+static
+double now_seconds(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+static
+void gap_stats_clear(gap_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+}
+
+
+static
+void gap_stats_update(gap_stats_t *stats, double gap) {
+    double delta = gap - stats->mean;
+
+    stats->count++;
+    stats->mean += delta / stats->count;
+    stats->m2 += delta * (gap - stats->mean);
+
+    if (stats->count == 1 || gap < stats->min) {
+        stats->min = gap;
+    }
+
+    if (stats->count == 1 || gap > stats->max) {
+        stats->max = gap;
+    }
+}
+
+
+static
+double gap_stats_jitter(const gap_stats_t *stats) {
+    return stats->count > 1 ? sqrt(stats->m2 / (stats->count - 1)) : 0.0;
+}
+
+
+static
+int matches_word(const char *text, const char **words, size_t words_number, size_t *length) {
+    for (size_t i = 0; i < words_number; ++i) {
+        size_t word_length = strlen(words[i]);
+
+        if (strncmp(text, words[i], word_length) == 0) {
+            *length = word_length;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
+static
+int is_decimal_field(const char *text, int digits) {
+    for (int i = 0; i < digits; ++i) {
+        if (text[i] < '0' || text[i] > '9') {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+
+static
+int is_hex_field(const char *text, int digits) {
+    for (int i = 0; i < digits; ++i) {
+        if (!((text[i] >= '0' && text[i] <= '9') || (text[i] >= 'A' && text[i] <= 'F'))) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+
+/* Sample with the axes selected by the AXES command in increasing order,
+ * all values either 3 decimal or 2 hexadecimal digits, e.g. X128Z004 or
+ * Y7FZ04, after a "D<sensor>" tag when the firmware samples several
+ * sensors, e.g. D1X128Z004
+ */
+static
+int is_acceleration_record(const char *text, uint32_t length) {
+    int digits = 0;
+
+    if (length > 2 && text[0] == 'D' && text[1] >= '0' && text[1] <= '9') {
+        text += 2;
+        length -= 2;
+    }
+
+    if (length > 0 && length % (1 + ACCELERATION_DIGITS) == 0 &&
+        length / (1 + ACCELERATION_DIGITS) <= 3 &&
+        is_decimal_field(text + 1, ACCELERATION_DIGITS)) {
+        digits = ACCELERATION_DIGITS;
+    } else if (length > 0 && length % (1 + ACCELERATION_HEX_DIGITS) == 0 &&
+               length / (1 + ACCELERATION_HEX_DIGITS) <= 3) {
+        digits = ACCELERATION_HEX_DIGITS;
+    } else {
+        return 0;
+    }
+
+    char previous_axis = 'X' - 1;
+
+    for (uint32_t i = 0; i < length; i += 1 + digits) {
+        if (text[i] <= previous_axis || text[i] > 'Z') {
+            return 0;
+        }
+
+        previous_axis = text[i];
+
+        if (digits == ACCELERATION_DIGITS ? !is_decimal_field(text + i + 1, digits)
+                                          : !is_hex_field(text + i + 1, digits)) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+
+/* Skips a non-empty run of decimal digits, returns NULL when there is none */
+static
+const char *skip_number(const char *text, const char *end) {
+    const char *start = text;
+
+    while (text < end && *text >= '0' && *text <= '9') {
+        ++text;
+    }
+
+    return text > start ? text : NULL;
+}
+
+
+/* Counters reply made of the prefix and a number after each tag, such as
+ * the queue counters "QE<enqueued>D<dropped>H<high water>" and the
+ * "KI<I2C timeouts>E<I2C errors>S<stream bytes dropped>C<capture
+ * overflows>" and the
+ * worst-case handler cycles "WI<I2C>T<sampling timer>D<USART TX DMA>"
+ */
+static
+int is_counters_record(const char *text, uint32_t length, char prefix, const char *tags) {
+    const char *end = text + length;
+
+    if (length < 1 || *text++ != prefix) {
+        return 0;
+    }
+
+    for (int i = 0; tags[i] != '\0'; ++i) {
+        if (text >= end || *text++ != tags[i] || (text = skip_number(text, end)) == NULL) {
+            return 0;
+        }
+    }
+
+    return text == end;
+}
+
+
+/* Skips an optionally negative number, with exactly two decimals when
+ * fraction is set; returns NULL when there is none
+ */
+static
+const char *skip_signed(const char *text, const char *end, int fraction) {
+    if (text < end && *text == '-') {
+        ++text;
+    }
+
+    if ((text = skip_number(text, end)) == NULL || !fraction) {
+        return text;
+    }
+
+    return end - text >= 3 && text[0] == '.' && is_decimal_field(text + 1, 2) ? text + 3 : NULL;
+}
+
+
+/* Summary of a window, "S<samples>" followed by 1 to 3 axes in increasing
+ * order, each as "X<min>,<max>,<mean>,<variance>" with two decimals in
+ * the last two, e.g. S40X-3,5,1.25,0.40Z54,58,56.10,0.90, optionally
+ * tagged D<sensor>
+ */
+static
+int is_summary_record(const char *text, uint32_t length) {
+    const char *end = text + length;
+    char previous_axis = 'X' - 1;
+
+    if (length > 2 && text[0] == 'D' && text[1] >= '0' && text[1] <= '9') {
+        text += 2;
+    }
+
+    if (text == end || *text++ != 'S' || (text = skip_number(text, end)) == NULL || text == end) {
+        return 0;
+    }
+
+    while (text < end) {
+        if (*text <= previous_axis || *text > 'Z') {
+            return 0;
+        }
+
+        previous_axis = *text++;
+
+        for (int field = 0; field < 4; ++field) {
+            if ((field > 0 && (text >= end || *text++ != ',')) ||
+                (text = skip_signed(text, end, field >= 2)) == NULL) {
+                return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+
+/* Returns whether the text is a click event followed by 1 to 3 axes */
+static
+int is_click_record(const char *text, uint32_t length) {
+    size_t word_length;
+
+    if (!matches_word(text, CLICK_EVENTS,
+                      sizeof(CLICK_EVENTS) / sizeof(CLICK_EVENTS[0]), &word_length) ||
+        word_length + 1 >= length || length > word_length + 4 || text[word_length] != ' ') {
+        return 0;
+    }
+
+    for (size_t i = word_length + 1; i < length; ++i) {
+        if (text[i] < 'X' || text[i] > 'Z' || (i > word_length + 1 && text[i] <= text[i - 1])) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+
+/* Returns the kind of a complete record (without the trailing CR LF)
+ * or -1 when the record is malformed
+ */
+static
+int classify_record(const char *text, uint32_t length) {
+    if (is_acceleration_record(text, length)) {
+        return RECORD_ACCELERATION;
+    }
+
+    size_t name_length;
+    size_t edge_length;
+
+    if (matches_word(text, BUTTON_NAMES,
+                     sizeof(BUTTON_NAMES) / sizeof(BUTTON_NAMES[0]), &name_length) &&
+        text[name_length] == ' ' &&
+        matches_word(text + name_length + 1, BUTTON_EDGES,
+                     sizeof(BUTTON_EDGES) / sizeof(BUTTON_EDGES[0]), &edge_length) &&
+        name_length + 1 + edge_length == length) {
+        return RECORD_BUTTON;
+    }
+
+    if (is_counters_record(text, length, 'Q', "EDH")) {
+        return RECORD_QUEUE_STATS;
+    }
+
+    if (is_counters_record(text, length, 'K', "IESC") ||
+        is_counters_record(text, length, 'W', "ITD")) {
+        return RECORD_COUNTERS;
+    }
+
+    if (is_summary_record(text, length)) {
+        return RECORD_SUMMARY;
+    }
+
+    if (matches_word(text, REPLIES, sizeof(REPLIES) / sizeof(REPLIES[0]), &name_length) &&
+        name_length == length) {
+        return RECORD_REPLY;
+    }
+
+    if ((matches_word(text, MOTION_EVENTS,
+                      sizeof(MOTION_EVENTS) / sizeof(MOTION_EVENTS[0]), &name_length) &&
+         name_length == length) ||
+        is_click_record(text, length)) {
+        return RECORD_MOTION_EVENT;
+    }
+
+    return -1;
+}
+
+
+static
+void account_record(int kind, double timestamp) {
+    if (chunk_records++ > 0) {
+        interval_stats.shared_chunk_records++;
+        total_stats.shared_chunk_records++;
+    }
+
+    if (kind < 0) {
+        interval_stats.format_errors++;
+        total_stats.format_errors++;
+        return;
+    }
+
+    interval_stats.records[kind]++;
+    total_stats.records[kind]++;
+
+    if (have_last_record) {
+        double gap = timestamp - last_record_time;
+
+        gap_stats_update(&interval_stats.gaps, gap);
+        gap_stats_update(&total_stats.gaps, gap);
+    }
+
+    last_record_time = timestamp;
+    have_last_record = 1;
+}
+
+
+/* Updates the shortfall of the sensor tagged in the sample */
+static
+void account_sample(const char *text, double timestamp) {
+    int sensor = text[0] == 'D' ? text[1] - '0' : 0;
+    uint64_t shortfall = 0;
+
+    if (samples_received[sensor]++ == 0) {
+        first_sample_time[sensor] = timestamp;
+    }
+
+    if (sample_period > 0.0) {
+        uint64_t expected = (uint64_t) ((timestamp - first_sample_time[sensor]) / sample_period + 0.5) + 1;
+
+        sample_shortfall[sensor] = expected > samples_received[sensor] ? expected - samples_received[sensor] : 0;
+    }
+
+    for (int i = 0; i < SENSORS_MAX; ++i) {
+        shortfall += sample_shortfall[i];
+    }
+
+    interval_stats.sample_shortfall = shortfall;
+    total_stats.sample_shortfall = shortfall;
+}
+
+
+/* Keeps the dropped messages count of a "QE<enqueued>D<dropped>H<high
+ * water>" record
+ */
+static
+void account_queue_stats(const char *text) {
+    uint64_t dropped = strtoull(strchr(text, 'D') + 1, NULL, 10);
+
+    interval_stats.firmware_dropped = dropped;
+    total_stats.firmware_dropped = dropped;
+}
+
+
+static
+void account_line(char *text, uint32_t length, double timestamp) {
+    int kind = classify_record(text, length);
+
+    text[length] = '\0';
+
+    if (kind == RECORD_ACCELERATION) {
+        account_sample(text, timestamp);
+    } else if (kind == RECORD_QUEUE_STATS) {
+        account_queue_stats(text);
+    }
+
+    account_record(kind, timestamp);
+}
+
+
+static
+uint32_t expected_block_size(void) {
+    if (block_used < BLOCK_HEADER_SIZE) {
+        return BLOCK_HEADER_SIZE;
+    }
+
+    return BLOCK_HEADER_SIZE + block[3] * BLOCK_SAMPLE_SIZE + 1;
+}
+
+
+static
+void finish_block(double timestamp) {
+    uint8_t checksum = 0;
+
+    for (uint32_t i = 2; i < block_used - 1; ++i) {
+        checksum += block[i];
+    }
+
+    if (checksum != block[block_used - 1] || block[3] > BLOCK_MAX_SAMPLES ||
+        (block[2] != 'B' && block[2] != 'E')) {
+        interval_stats.block_errors++;
+        total_stats.block_errors++;
+        account_record(-1, timestamp);
+        return;
+    }
+
+    uint16_t sequence = block[4] | (block[5] << 8);
+
+    if (have_block_sequence && sequence != expected_block_sequence && sequence != 0) {
+        interval_stats.block_sequence_gaps++;
+        total_stats.block_sequence_gaps++;
+    }
+
+    have_block_sequence = block[2] != 'E';
+    expected_block_sequence = sequence + 1;
+
+    interval_stats.capture_samples += block[3];
+    total_stats.capture_samples += block[3];
+
+    account_record(RECORD_CAPTURE_BLOCK, timestamp);
+}
+
+
+/* Collects a binary capture block started by the sync bytes */
+static
+void consume_block_byte(uint8_t c, double timestamp) {
+    block[block_used++] = c;
+
+    if (block_used == 2 && c != BLOCK_SYNC_1) {
+        in_block = 0;
+        account_record(-1, timestamp);
+        return;
+    }
+
+    if (block_used >= BLOCK_HEADER_SIZE &&
+        (block[3] > BLOCK_MAX_SAMPLES || block_used == expected_block_size())) {
+        in_block = 0;
+        finish_block(timestamp);
+    }
+}
+
+
+static
+void consume_byte(char c, double timestamp) {
+    if (in_block) {
+        consume_block_byte(c, timestamp);
+        return;
+    }
+
+    /* Double-buffered streaming pads idle buffers with NUL bytes */
+    if (line_used == 0 && c == '\0') {
+        interval_stats.padding_bytes++;
+        total_stats.padding_bytes++;
+        return;
+    }
+
+    if (line_used == 0 && (uint8_t) c == BLOCK_SYNC_0) {
+        in_block = 1;
+        block_used = 0;
+        consume_block_byte(c, timestamp);
+        return;
+    }
+
+    if (c == '\n') {
+        if (line_overflowed) {
+            interval_stats.overlong_lines++;
+            total_stats.overlong_lines++;
+            account_record(-1, timestamp);
+        } else if (line_used > 0 && line[line_used - 1] == '\r') {
+            account_line(line, line_used - 1, timestamp);
+        } else {
+            account_record(-1, timestamp);
+        }
+
+        line_used = 0;
+        line_overflowed = 0;
+    } else if (line_used < LINE_BUFFER_SIZE) {
+        line[line_used++] = c;
+    } else {
+        line_overflowed = 1;
+    }
+}
+
+
+static
+uint64_t records_sum(const stream_stats_t *stats) {
+    uint64_t sum = 0;
+
+    for (int i = 0; i < RECORD_KINDS_NUMBER; ++i) {
+        sum += stats->records[i];
+    }
+
+    return sum;
+}
+
+
+static
+void print_stats(const char *scope, const stream_stats_t *stats, double elapsed, int json) {
+    uint64_t records = records_sum(stats);
+    double seconds = elapsed > 0.0 ? elapsed : 1.0;
+
+    if (json) {
+        printf("{\"scope\":\"%s\",\"elapsed_s\":%.3f,\"bytes\":%llu,\"padding_bytes\":%llu,"
+               "\"records\":%llu",
+               scope, elapsed, (unsigned long long) stats->bytes,
+               (unsigned long long) stats->padding_bytes, (unsigned long long) records);
+
+        for (int i = 0; i < RECORD_KINDS_NUMBER; ++i) {
+            printf(",\"%s\":%llu", RECORD_KIND_NAMES[i], (unsigned long long) stats->records[i]);
+        }
+
+        printf(",\"capture_samples\":%llu,\"block_errors\":%llu,\"block_sequence_gaps\":%llu",
+               (unsigned long long) stats->capture_samples,
+               (unsigned long long) stats->block_errors,
+               (unsigned long long) stats->block_sequence_gaps);
+
+        printf(",\"sample_shortfall\":%llu,\"firmware_dropped\":%llu,\"shared_chunk_records\":%llu",
+               (unsigned long long) stats->sample_shortfall,
+               (unsigned long long) stats->firmware_dropped,
+               (unsigned long long) stats->shared_chunk_records);
+
+        printf(",\"msgs_per_s\":%.2f,\"bytes_per_s\":%.2f,\"format_errors\":%llu,"
+               "\"overlong_lines\":%llu,\"gap_min_ms\":%.3f,\"gap_mean_ms\":%.3f,"
+               "\"gap_max_ms\":%.3f,\"jitter_ms\":%.3f}\n",
+               records / seconds, stats->bytes / seconds,
+               (unsigned long long) stats->format_errors,
+               (unsigned long long) stats->overlong_lines,
+               stats->gaps.min * 1e3, stats->gaps.mean * 1e3,
+               stats->gaps.max * 1e3, gap_stats_jitter(&stats->gaps) * 1e3);
+    } else {
+        printf("%-8s %8.3f s  %8.2f msg/s  %9.2f B/s  errors %llu  behind %llu  dropped %llu  "
+               "gap %.3f/%.3f/%.3f ms  jitter %.3f ms\n",
+               scope, elapsed, records / seconds, stats->bytes / seconds,
+               (unsigned long long) stats->format_errors,
+               (unsigned long long) stats->sample_shortfall,
+               (unsigned long long) stats->firmware_dropped,
+               stats->gaps.min * 1e3, stats->gaps.mean * 1e3,
+               stats->gaps.max * 1e3, gap_stats_jitter(&stats->gaps) * 1e3);
+    }
+
+    fflush(stdout);
+}
+
+
+static
+speed_t baud_to_speed(uint32_t baud_rate) {
+    switch (baud_rate) {
+        case 9600:
+            return B9600;
+        case 19200:
+            return B19200;
+        case 38400:
+            return B38400;
+        case 57600:
+            return B57600;
+        case 115200:
+            return B115200;
+        case 230400:
+            return B230400;
+        case 460800:
+            return B460800;
+        case 921600:
+            return B921600;
+        default:
+            return B0;
+    }
+}
+
+
+static
+int open_device(const options_t *options) {
+    int fd = open(options->device, O_RDONLY | O_NOCTTY);
+
+    if (fd < 0) {
+        fprintf(stderr, "receiver: cannot open %s: %s\n", options->device, strerror(errno));
+        return -1;
+    }
+
+    struct termios tio;
+
+    if (tcgetattr(fd, &tio) == 0) {
+        speed_t speed = baud_to_speed(options->baud_rate);
+
+        if (speed == B0) {
+            fprintf(stderr, "receiver: unsupported baud rate %u\n", options->baud_rate);
+            close(fd);
+            return -1;
+        }
+
+        cfmakeraw(&tio);
+        cfsetispeed(&tio, speed);
+        cfsetospeed(&tio, speed);
+
+        tio.c_cflag |= CLOCAL | CREAD;
+        tio.c_cc[VMIN] = 1;
+        tio.c_cc[VTIME] = 0;
+
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+
+    return fd;
+}
+
+
+static
+void usage(const char *program) {
+    fprintf(stderr,
+            "usage: %s [-b baud] [-p period_us] [-i interval_ms] [-t duration_ms] [-j] [-q] device\n"
+            "  -b  line speed, also used to time the bytes of one read (default %u)\n"
+            "  -p  sampling period in microseconds, for the sample shortfall\n"
+            "  -i  reporting interval in milliseconds (default %u)\n"
+            "  -t  stop after the given time, 0 runs until EOF (default 0)\n"
+            "  -j  print JSON lines instead of text\n"
+            "  -q  print only the final summary\n",
+            program, DEFAULT_BAUD_RATE, DEFAULT_REPORT_INTERVAL_MS);
+}
+
+
+static
+int parse_options(int argc, char **argv, options_t *options) {
+    int opt;
+
+    options->baud_rate = DEFAULT_BAUD_RATE;
+    options->sample_period_us = 0;
+    options->report_interval_ms = DEFAULT_REPORT_INTERVAL_MS;
+    options->duration_ms = 0;
+    options->json = 0;
+    options->quiet = 0;
+
+    while ((opt = getopt(argc, argv, "b:p:i:t:jq")) != -1) {
+        switch (opt) {
+            case 'b':
+                options->baud_rate = strtoul(optarg, NULL, 10);
+                break;
+            case 'p':
+                options->sample_period_us = strtoul(optarg, NULL, 10);
+                break;
+            case 'i':
+                options->report_interval_ms = strtoul(optarg, NULL, 10);
+                break;
+            case 't':
+                options->duration_ms = strtoul(optarg, NULL, 10);
+                break;
+            case 'j':
+                options->json = 1;
+                break;
+            case 'q':
+                options->quiet = 1;
+                break;
+            default:
+                return -1;
+        }
+    }
+
+    if (optind + 1 != argc || options->report_interval_ms == 0 || options->baud_rate == 0) {
+        return -1;
+    }
+
+    options->device = argv[optind];
+
+    return 0;
+}
+
+
+int main(int argc, char **argv) {
+    options_t options;
+
+    if (parse_options(argc, argv, &options) != 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    int fd = open_device(&options);
+
+    if (fd < 0) {
+        return 1;
+    }
+
+    double start_time = now_seconds();
+    double interval_start = start_time;
+    double interval_length = options.report_interval_ms / 1e3;
+    double deadline = start_time + options.duration_ms / 1e3;
+    double byte_time = (double) BITS_PER_FRAME / options.baud_rate;
+
+    sample_period = options.sample_period_us / 1e6;
+
+    char chunk[READ_CHUNK_SIZE];
+
+    for (;;) {
+        double now = now_seconds();
+
+        if (options.duration_ms != 0 && now >= deadline) {
+            break;
+        }
+
+        if (now - interval_start >= interval_length) {
+            if (!options.quiet) {
+                print_stats("interval", &interval_stats, now - interval_start, options.json);
+            }
+
+            memset(&interval_stats, 0, sizeof(interval_stats));
+            gap_stats_clear(&interval_stats.gaps);
+            interval_start = now;
+        }
+
+        struct pollfd pfd = {.fd = fd, .events = POLLIN};
+        int timeout_ms = (int) ((interval_start + interval_length - now) * 1e3) + 1;
+
+        if (poll(&pfd, 1, timeout_ms) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            perror("receiver: poll");
+            break;
+        }
+
+        if (!(pfd.revents & (POLLIN | POLLHUP | POLLERR))) {
+            continue;
+        }
+
+        ssize_t received = read(fd, chunk, sizeof(chunk));
+
+        if (received <= 0) {
+            /* EOF or hang-up of the writer side of a pty */
+            break;
+        }
+
+        double timestamp = now_seconds();
+        double previous_chunk_time = total_stats.bytes == 0 ? 0.0 : last_byte_time;
+
+        if (total_stats.bytes == 0) {
+            first_byte_time = timestamp;
+        }
+
+        last_byte_time = timestamp;
+
+        interval_stats.bytes += received;
+        total_stats.bytes += received;
+
+        /* Bytes of one read arrived one frame time apart up to the time
+         * of the read, but not before the previous read returned, so each
+         * record is timestamped with its own last byte
+         */
+        chunk_records = 0;
+
+        for (ssize_t i = 0; i < received; ++i) {
+            double byte_timestamp = timestamp - (received - 1 - i) * byte_time;
+
+            consume_byte(chunk[i], byte_timestamp > previous_chunk_time ? byte_timestamp
+                                                                        : previous_chunk_time);
+        }
+    }
+
+    /* Rates of the whole run cover only the time the stream was active */
+    print_stats("total", &total_stats, last_byte_time - first_byte_time, options.json);
+
+    close(fd);
+
+    return total_stats.format_errors == 0 ? 0 : 3;
+}
@@ -0,0 +1,138 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "command_parser.h"
+#include "sample_text.h"
+#include "summary.h"
+
+
+#define     SENSORS_NUMBER                        4
+#define     ALL_AXES            (COMMAND_AXIS_X | COMMAND_AXIS_Y | COMMAND_AXIS_Z)
+
+
+/* Checks of final/summary.c as main.c uses it with several sensors: one
+ * window per sensor fed with interleaved samples, each sent as a summary
+ * record tagged with its sensor
+ */
+
+
+/* Samples of each sensor, read one sensor after another as the sampling
+ * timer does; the last sensor returns none
+ */
+static const int8_t SAMPLES_0[][3] = {{0, 0, 50}, {1, -1, 50}, {2, -2, 50}, {3, -3, 50}};
+static const int8_t SAMPLES_1[][3] = {{10, 20, 30}, {10, 20, 30}, {10, 20, 30}, {10, 20, 30},
+                                      {10, 20, 30}};
+static const int8_t SAMPLES_2[][3] = {{-128, 0, 0}, {127, 0, 0}};
+
+
+static const struct {
+    const int8_t (*samples)[3];
+    uint32_t number;
+    const char *record;
+} SENSORS[SENSORS_NUMBER] = {
+        {SAMPLES_0, 4, "D0S4X0,3,1.50,1.25Y-3,0,-1.50,1.25Z50,50,50.00,0.00\r\n"},
+        {SAMPLES_1, 5, "D1S5X10,10,10.00,0.00Y20,20,20.00,0.00Z30,30,30.00,0.00\r\n"},
+        {SAMPLES_2, 2, "D2S2X-128,127,-0.50,16256.25Y0,0,0.00,0.00Z0,0,0.00,0.00\r\n"},
+        {NULL, 0, NULL}
+};
+
+
+static summary_t summaries[SENSORS_NUMBER];
+static int failures;
+
+
+static
+void check(const char *name, int passed, const char *detail) {
+    if (!passed) {
+        printf("FAIL %-40s %s\n", name, detail);
+        ++failures;
+    } else {
+        printf("ok   %s\n", name);
+    }
+}
+
+
+static
+void feed_interleaved(void) {
+    for (uint32_t i = 0; ; ++i) {
+        int fed = 0;
+
+        for (int sensor = 0; sensor < SENSORS_NUMBER; ++sensor) {
+            if (i < SENSORS[sensor].number) {
+                const int8_t *sample = SENSORS[sensor].samples[i];
+
+                summary_update(&summaries[sensor], sample[0], sample[1], sample[2]);
+                fed = 1;
+            }
+        }
+
+        if (!fed) {
+            return;
+        }
+    }
+}
+
+
+/* Each window counts and summarizes only the samples of its sensor */
+static
+void test_windows_per_sensor(void) {
+    char text[SENSOR_TAG_LENGTH + SUMMARY_TEXT_MAX_LENGTH + 1];
+    char name[64];
+
+    for (int sensor = 0; sensor < SENSORS_NUMBER; ++sensor) {
+        summary_reset(&summaries[sensor]);
+    }
+
+    feed_interleaved();
+
+    for (int sensor = 0; sensor < SENSORS_NUMBER; ++sensor) {
+        summary_t window;
+
+        summary_take(&summaries[sensor], &window);
+        snprintf(name, sizeof(name), "window of sensor %d", sensor);
+
+        if (SENSORS[sensor].record == NULL) {
+            check(name, window.samples == 0, "has samples of other sensors");
+            continue;
+        }
+
+        uint32_t length = format_sensor_tag(text, sensor);
+
+        length += format_summary(text + length, &window, ALL_AXES);
+        text[length] = '\0';
+
+        check(name, strcmp(text, SENSORS[sensor].record) == 0, text);
+    }
+}
+
+
+/* Taking a window starts a new one for that sensor only */
+static
+void test_take_starts_new_window(void) {
+    summary_t window;
+
+    for (int sensor = 0; sensor < SENSORS_NUMBER; ++sensor) {
+        summary_reset(&summaries[sensor]);
+    }
+
+    feed_interleaved();
+    summary_take(&summaries[0], &window);
+    summary_take(&summaries[0], &window);
+
+    check("taken window starts empty", window.samples == 0, "samples left in the window");
+
+    summary_take(&summaries[1], &window);
+
+    check("other windows are kept", window.samples == SENSORS[1].number, "window lost its samples");
+}
+
+
+int main(void) {
+    test_windows_per_sensor();
+    test_take_starts_new_window();
+
+    printf("%d failures\n", failures);
+
+    return failures == 0 ? 0 : 1;
+}
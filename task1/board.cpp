@@ -0,0 +1,128 @@
+#include <stm32.h>
+#include "board.h"
+#include "peripherals.hpp"
+
+
+using namespace peripherals;
+
+
+namespace {
+
+
+/* LED on the pin, lit by a low level when ActiveLow */
+template <typename P, bool ActiveLow>
+struct Led {
+    static_assert(P::mode == Mode::Output, "LEDs need output pins");
+
+    static void on() {
+        if constexpr (ActiveLow) {
+            P::reset();
+        } else {
+            P::set();
+        }
+    }
+
+    static void off() {
+        if constexpr (ActiveLow) {
+            P::set();
+        } else {
+            P::reset();
+        }
+    }
+
+    static void toggle() {
+        P::gpio()->BSRR = (P::gpio()->ODR & P::mask) ? P::mask << 16 : P::mask;
+    }
+};
+
+
+using RedPin = OutputPin<Port::A, 6>;
+using GreenPin = OutputPin<Port::A, 7>;
+using BluePin = OutputPin<Port::B, 0>;
+using Green2Pin = OutputPin<Port::A, 5>;
+using ConsoleTx = AlternatePin<Port::A, 2, Signal::Usart2Tx, OutputType::PushPull, Speed::Fast>;
+using ConsoleRx = AlternatePin<Port::A, 3, Signal::Usart2Rx, OutputType::PushPull, Speed::Fast>;
+
+
+using RedLed = Led<RedPin, true>;
+using GreenLed = Led<GreenPin, true>;
+using BlueLed = Led<BluePin, true>;
+using Green2Led = Led<Green2Pin, false>;
+
+
+using Console = Usart<2, ConsoleTx, ConsoleRx>;
+
+
+static_assert(wired<Console>, "incomplete wiring");
+
+
+using PortA = PortConfiguration<Port::A, RedPin, GreenPin, Green2Pin, ConsoleTx, ConsoleRx>;
+using PortB = PortConfiguration<Port::B, BluePin>;
+
+
+} /* namespace */
+
+
+void PINS_configure(void) {
+    PortA::configure();
+    PortB::configure();
+}
+
+
+void LED_on(led_t led) {
+    switch (led) {
+        case LED_RED:
+            RedLed::on();
+            break;
+        case LED_GREEN:
+            GreenLed::on();
+            break;
+        case LED_BLUE:
+            BlueLed::on();
+            break;
+        case LED_GREEN2:
+            Green2Led::on();
+            break;
+    }
+}
+
+
+void LED_off(led_t led) {
+    switch (led) {
+        case LED_RED:
+            RedLed::off();
+            break;
+        case LED_GREEN:
+            GreenLed::off();
+            break;
+        case LED_BLUE:
+            BlueLed::off();
+            break;
+        case LED_GREEN2:
+            Green2Led::off();
+            break;
+    }
+}
+
+
+void LED_toggle(led_t led) {
+    switch (led) {
+        case LED_RED:
+            RedLed::toggle();
+            break;
+        case LED_GREEN:
+            GreenLed::toggle();
+            break;
+        case LED_BLUE:
+            BlueLed::toggle();
+            break;
+        case LED_GREEN2:
+            Green2Led::toggle();
+            break;
+    }
+}
+
+
+uint32_t CONSOLE_brr(uint32_t baud_rate) {
+    return Console::brr(PCLK_HZ, baud_rate);
+}
@@ -0,0 +1,54 @@
+#ifndef BOARD_H
+#define BOARD_H
+
+
+/* LEDs and USART2 pins of the first task, described in board.cpp with
+ * the compile-time layer of ../final/peripherals.hpp
+ */
+
+
+/* The core and APB1 run from the 16 MHz HSI */
+#define     PCLK_HZ                       16000000U
+
+
+/* The red, green and blue LEDs light when their pin is low, the second
+ * green one when its pin is high
+ */
+typedef enum {
+    LED_RED,
+    LED_GREEN,
+    LED_BLUE,
+    LED_GREEN2
+} led_t;
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* Configures the LED and USART2 pins, writing each register of a port
+ * once; the GPIO ports must be clocked
+ */
+void PINS_configure(void);
+
+
+void LED_on(led_t);
+
+
+void LED_off(led_t);
+
+
+void LED_toggle(led_t);
+
+
+/* BRR value of USART2 at the baud rate */
+uint32_t CONSOLE_brr(uint32_t);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* BOARD_H */
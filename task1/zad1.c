@@ -1,40 +1,9 @@
 #include <delay.h>
-#include <gpio.h>
 #include <stm32.h>
 #include <stdlib.h>
 #include <string.h>
+#include "board.h"
 
-#define RED_LED_GPIO GPIOA
-#define GREEN_LED_GPIO GPIOA
-#define BLUE_LED_GPIO GPIOB
-#define GREEN2_LED_GPIO GPIOA
-#define RED_LED_PIN 6
-#define GREEN_LED_PIN 7
-#define BLUE_LED_PIN 0
-#define GREEN2_LED_PIN 5
-
-#define RedLEDon() \
-    RED_LED_GPIO->BSRR = 1 << (RED_LED_PIN + 16)
-#define RedLEDoff() \
-    RED_LED_GPIO->BSRR = 1 << RED_LED_PIN
-
-#define GreenLEDon() \
-    GREEN_LED_GPIO->BSRR = 1 << (GREEN_LED_PIN + 16)
-#define GreenLEDoff() \
-    GREEN_LED_GPIO->BSRR = 1 << GREEN_LED_PIN
-
-#define BlueLEDon() \
-    BLUE_LED_GPIO->BSRR = 1 << (BLUE_LED_PIN + 16)
-#define BlueLEDoff() \
-    BLUE_LED_GPIO->BSRR = 1 << BLUE_LED_PIN
-
-#define Green2LEDon() \
-    GREEN2_LED_GPIO->BSRR = 1 << GREEN2_LED_PIN
-#define Green2LEDoff() \
-    GREEN2_LED_GPIO->BSRR = 1 << (GREEN2_LED_PIN + 16)
-
-#define HSI_HZ 16000000U
-#define PCLK1_HZ HSI_HZ
 #define BAUD_RATE 9600U
 
 #define USART_WordLength_8b 0x0000
@@ -72,15 +41,6 @@ static const uint32_t MESS_LENGTHS[2 * BUTTON_NUMS] = {
         14, 15, 14, 15, 15, 16, 12, 13, 14, 15, 14, 15, 13, 15
 };
 
-static __IO uint32_t
-red_led_state;
-static __IO uint32_t
-green_led_state;
-static __IO uint32_t
-blue_led_state;
-static __IO uint32_t
-green2_led_state;
-
 static uint32_t button_states[BUTTON_NUMS] = {0};
 static uint32_t button_to_reg_map[BUTTON_NUMS] = {13, 3, 4, 5, 6, 10, 0};
 
@@ -137,42 +97,16 @@ uint32_t parse_query(char *recv_buffer, uint32_t buffer_used) {
         return 1;
     }
 
-    if (LED_char == 'R') {
-        if (opt_char == '0') {
-            RedLEDoff();
-        } else if (opt_char == '1') {
-            RedLEDon();
-        } else {
-            red_led_state = red_led_state ^ (1 << RED_LED_PIN | 1 << (RED_LED_PIN + 16));
-            RED_LED_GPIO->BSRR = blue_led_state;
-        }
-    } else if (LED_char == 'G') {
-        if (opt_char == '0') {
-            GreenLEDoff();
-        } else if (opt_char == '1') {
-            GreenLEDon();
-        } else {
-            green_led_state = green_led_state ^ (1 << GREEN_LED_PIN | 1 << (GREEN_LED_PIN + 16));
-            GREEN_LED_GPIO->BSRR = green_led_state;
-        }
-    } else if (LED_char == 'B') {
-        if (opt_char == '0') {
-            BlueLEDoff();
-        } else if (opt_char == '1') {
-            BlueLEDon();
-        } else {
-            blue_led_state = blue_led_state ^ (1 << BLUE_LED_PIN | 1 << (BLUE_LED_PIN + 16));
-            BLUE_LED_GPIO->BSRR = blue_led_state;
-        }
+    led_t led = LED_char == 'R' ? LED_RED :
+                LED_char == 'G' ? LED_GREEN :
+                LED_char == 'B' ? LED_BLUE : LED_GREEN2;
+
+    if (opt_char == '0') {
+        LED_off(led);
+    } else if (opt_char == '1') {
+        LED_on(led);
     } else {
-        if (opt_char == '0') {
-            Green2LEDoff();
-        } else if (opt_char == '1') {
-            Green2LEDon();
-        } else {
-            green2_led_state = green2_led_state ^ (1 << GREEN2_LED_PIN | 1 << (GREEN2_LED_PIN + 16));
-            GREEN2_LED_GPIO->BSRR = green2_led_state;
-        }
+        LED_toggle(led);
     }
 
     return 2;
@@ -229,61 +163,19 @@ int main(void) {
     USART2->CR2 = USART_StopBits_1;
     USART2->CR3 = USART_FlowControl_None;
 
-    USART2->BRR = (PCLK1_HZ + (BAUD_RATE / 2U)) /
-                  BAUD_RATE;
+    USART2->BRR = CONSOLE_brr(BAUD_RATE);
 
     USART2->CR1 |= USART_Enable;
 
     __NOP();
 
-    RedLEDoff();
-    GreenLEDoff();
-    BlueLEDoff();
-    Green2LEDoff();
-
-    red_led_state = 1 << RED_LED_PIN;
-    green_led_state = 1 << GREEN_LED_PIN;
-    blue_led_state = 1 << BLUE_LED_PIN;
-    green2_led_state = 1 << (GREEN2_LED_PIN + 16);
-
-    GPIOoutConfigure(RED_LED_GPIO,
-                     RED_LED_PIN,
-                     GPIO_OType_PP,
-                     GPIO_Low_Speed,
-                     GPIO_PuPd_NOPULL);
-
-    GPIOoutConfigure(GREEN_LED_GPIO,
-                     GREEN_LED_PIN,
-                     GPIO_OType_PP,
-                     GPIO_Low_Speed,
-                     GPIO_PuPd_NOPULL);
-
-    GPIOoutConfigure(BLUE_LED_GPIO,
-                     BLUE_LED_PIN,
-                     GPIO_OType_PP,
-                     GPIO_Low_Speed,
-                     GPIO_PuPd_NOPULL);
-
-    GPIOoutConfigure(GREEN2_LED_GPIO,
-                     GREEN2_LED_PIN,
-                     GPIO_OType_PP,
-                     GPIO_Low_Speed,
-                     GPIO_PuPd_NOPULL);
-
-    GPIOafConfigure(GPIOA,
-                    2,
-                    GPIO_OType_PP,
-                    GPIO_Fast_Speed,
-                    GPIO_PuPd_NOPULL,
-                    GPIO_AF_USART2);
-
-    GPIOafConfigure(GPIOA,
-                    3,
-                    GPIO_OType_PP,
-                    GPIO_Fast_Speed,
-                    GPIO_PuPd_NOPULL,
-                    GPIO_AF_USART2);
+    /* Off before the pins turn into outputs */
+    LED_off(LED_RED);
+    LED_off(LED_GREEN);
+    LED_off(LED_BLUE);
+    LED_off(LED_GREEN2);
 
+    PINS_configure();
 
     for (uint32_t i = 0; i < BUTTON_NUMS; ++i) {
         button_states[i] = get_button_state_from_controller(i);
@@ -1,7 +1,6 @@
 #include <gpio.h>
 #include <irq.h>
 #include <stm32.h>
-#include <string.h>
 
 #define BAUD_RATE 9600U
 #define HSI_HZ 16000000U
@@ -12,49 +11,91 @@
 typedef struct {
     GPIO_TypeDef *gpio;
     uint32_t reg;
-    char *message_press;
-    char *message_release;
     uint32_t neg;
 } button_t;
 
-#define STR_LEFT "LEFT"
-#define STR_RIGHT "RIGHT"
-#define STR_UP "UP"
-#define STR_DOWN "DOWN"
-#define STR_FIRE "FIRE"
-#define STR_USER "USER"
-#define STR_MODE "MODE"
+static
+button_t controller_buttons[CONTROLLER_BUTTONS_NUMBER] = {
+        {GPIOB, 3,  0},
+        {GPIOB, 4,  0},
+        {GPIOB, 5,  0},
+        {GPIOB, 6,  0},
+        {GPIOB, 10, 0},
+        {GPIOC, 13, 0},
+        {GPIOA, 0,  1}
+};
 
-#define PRESSED " PRESSED\r\n"
-#define RELEASED " RELEASED\r\n"
+/* Queued events are single bytes: the button index shifted left by one
+ * with the edge in the lowest bit, or EVENT_STATS for the counters reply.
+ * The text is looked up only when the DMA transfer is set up.
+ */
+#define EVENT_PRESS                     0
+#define EVENT_RELEASE                   1
+#define EVENT_STATS                     0xFF
 
-#define MSG(BUTTON, TYPE) BUTTON ## #TYPE
+#define BUTTON_EVENT(BUTTON, EDGE)      ((uint8_t) ((BUTTON) << 1 | (EDGE)))
 
-static
-button_t controller_buttons[CONTROLLER_BUTTONS_NUMBER] = {
-        {GPIOB, 3, MSG(STR_LEFT, RELEASED),  "LEFT RELEASED\r\n",  0},
-        {GPIOB, 4, MSG(STR_RIGHT, RELEASED), "RIGHT RELEASED\r\n", 0},
-        {GPIOB, 5,  "UP PRESSED\r\n",        "UP RELEASED\r\n",    0},
-        {GPIOB, 6,  "DOWN PRESSED\r\n",      "DOWN RELEASED\r\n",  0},
-        {GPIOB, 10, "FIRE PRESSED\r\n",      "FIRE RELEASED\r\n",  0},
-        {GPIOC, 13, "USER PRESSED\r\n",      "USER RELEASED\r\n",  0},
-        {GPIOA, 0,  "MODE PRESET\r\n",       "MODE RELEASED\r\n",  1}
+#define EVENT_TEXT(TEXT)                {TEXT, sizeof(TEXT) - 1}
+
+typedef struct {
+    const char *text;
+    uint32_t length;
+} event_text_t;
+
+static const
+event_text_t EVENT_TEXTS[2 * CONTROLLER_BUTTONS_NUMBER] = {
+        EVENT_TEXT("LEFT PRESSED\r\n"),  EVENT_TEXT("LEFT RELEASED\r\n"),
+        EVENT_TEXT("RIGHT PRESSED\r\n"), EVENT_TEXT("RIGHT RELEASED\r\n"),
+        EVENT_TEXT("UP PRESSED\r\n"),    EVENT_TEXT("UP RELEASED\r\n"),
+        EVENT_TEXT("DOWN PRESSED\r\n"),  EVENT_TEXT("DOWN RELEASED\r\n"),
+        EVENT_TEXT("FIRE PRESSED\r\n"),  EVENT_TEXT("FIRE RELEASED\r\n"),
+        EVENT_TEXT("USER PRESSED\r\n"),  EVENT_TEXT("USER RELEASED\r\n"),
+        EVENT_TEXT("MODE PRESET\r\n"),   EVENT_TEXT("MODE RELEASED\r\n")
 };
 
 #define MESSAGES_QUEUE_SIZE             512
+#define STATS_MESSAGE_SIZE              40
+
+#define COMMAND_QUERY_STATS             'S'
+#define COMMAND_RESET_STATS             'R'
+#define COMMAND_POLICY_DROP_NEWEST      'N'
+#define COMMAND_POLICY_DROP_OLDEST      'O'
+#define COMMAND_POLICY_COALESCE         'L'
+
+typedef enum {
+    POLICY_DROP_NEWEST,
+    POLICY_DROP_OLDEST,
+    POLICY_COALESCE
+} queue_policy_t;
 
 static struct {
-    char *buffer[MESSAGES_QUEUE_SIZE];
+    uint8_t buffer[MESSAGES_QUEUE_SIZE];
     int32_t read_pos;
     int32_t insert_pos;
     int32_t used;
+    queue_policy_t policy;
+    uint32_t enqueued;
+    uint32_t dropped;
+    uint32_t high_water;
 } messages;
 
+/* The counters reply is formatted once and stays unchanged until it has
+ * been sent or dropped; requests arriving meanwhile are ignored
+ */
+static char stats_message[STATS_MESSAGE_SIZE];
+static uint32_t stats_message_length;
+static uint8_t stats_pending;
+
+/* Event on the DMA */
+static uint8_t sending_event;
+static char command;
+
 static
 void clear_queue(void) {
     messages.read_pos = 0;
     messages.insert_pos = 0;
     messages.used = 0;
+    messages.policy = POLICY_DROP_NEWEST;
 }
 
 static
@@ -68,20 +109,86 @@ int32_t is_queue_full(void) {
 }
 
 static
-char *queue_poll(void) {
-    char *ptr = messages.buffer[messages.read_pos];
+uint8_t queue_poll(void) {
+    uint8_t event = messages.buffer[messages.read_pos];
     messages.read_pos = (messages.read_pos + 1) % MESSAGES_QUEUE_SIZE;
     messages.used--;
-    return ptr;
+    return event;
 }
 
 static
-void queue_push(char *ptr) {
-    messages.buffer[messages.insert_pos] = ptr;
+void queue_push(uint8_t event) {
+    messages.buffer[messages.insert_pos] = event;
     messages.insert_pos = (messages.insert_pos + 1) % MESSAGES_QUEUE_SIZE;
     messages.used++;
 }
 
+static
+void discard(uint8_t event) {
+    messages.dropped++;
+
+    if (event == EVENT_STATS) {
+        stats_pending = 0;
+    }
+}
+
+/* Press and release edges and the counters reply cannot stand in for one
+ * another, so coalescing never overwrites the newest event and drops the
+ * oldest one as DROP_OLDEST does
+ */
+static
+void queue_offer(uint8_t event) {
+    if (is_queue_full()) {
+        if (messages.policy == POLICY_DROP_NEWEST) {
+            discard(event);
+            return;
+        }
+
+        discard(queue_poll());
+    }
+
+    queue_push(event);
+    messages.enqueued++;
+
+    if ((uint32_t) messages.used > messages.high_water) {
+        messages.high_water = messages.used;
+    }
+}
+
+static
+char *write_decimal(char *text, uint32_t value) {
+    char digits[10];
+    int length = 0;
+
+    do {
+        digits[length++] = (value % 10) + '0';
+        value /= 10;
+    } while (value > 0);
+
+    while (length > 0) {
+        *text++ = digits[--length];
+    }
+
+    return text;
+}
+
+static
+void format_stats(void) {
+    char *text = stats_message;
+
+    *text++ = 'Q';
+    *text++ = 'E';
+    text = write_decimal(text, messages.enqueued);
+    *text++ = 'D';
+    text = write_decimal(text, messages.dropped);
+    *text++ = 'H';
+    text = write_decimal(text, messages.high_water);
+    *text++ = '\r';
+    *text++ = '\n';
+
+    stats_message_length = text - stats_message;
+}
+
 static
 void configure_button(button_t *button) {
     GPIOinConfigure(button->gpio,
@@ -163,28 +270,38 @@ uint32_t is_pressed(button_t *button) {
 }
 
 static
-void send_to_DMA1(char *message) {
-    DMA1_Stream6->M0AR = (uint32_t) message;
-    DMA1_Stream6->NDTR = strlen(message);
+void send_to_DMA1(uint8_t event) {
+    sending_event = event;
+
+    if (event == EVENT_STATS) {
+        DMA1_Stream6->M0AR = (uint32_t) stats_message;
+        DMA1_Stream6->NDTR = stats_message_length;
+    } else {
+        DMA1_Stream6->M0AR = (uint32_t) EVENT_TEXTS[event].text;
+        DMA1_Stream6->NDTR = EVENT_TEXTS[event].length;
+    }
+
     DMA1_Stream6->CR |= DMA_SxCR_EN;
 }
 
+static
+void send(uint8_t event) {
+    if ((DMA1_Stream6->CR & DMA_SxCR_EN) == 0 &&
+        (DMA1->HISR & DMA_HISR_TCIF6) == 0) {
+        send_to_DMA1(event);
+    } else {
+        queue_offer(event);
+    }
+}
+
 static
 void interrupt_handler(uint32_t EXTI_PR_STATE,
                        uint32_t LINE_INTERRUPT_STATE,
                        button_t *button) {
     if (EXTI_PR_STATE & LINE_INTERRUPT_STATE) {
-        char *message = is_pressed(button)
-                        ? button->message_release
-                        : button->message_press;
+        uint8_t edge = is_pressed(button) ? EVENT_RELEASE : EVENT_PRESS;
 
-        if ((DMA1_Stream6->CR & DMA_SxCR_EN) == 0 &&
-            (DMA1->HISR & DMA_HISR_TCIF6) == 0) {
-
-            send_to_DMA1(message);
-        } else if (!is_queue_full()) {
-            queue_push(message);
-        }
+        send(BUTTON_EVENT(button - controller_buttons, edge));
 
         EXTI->PR = LINE_INTERRUPT_STATE;
     }
@@ -196,12 +313,55 @@ void DMA1_Stream6_IRQHandler(void) {
     if (isr & DMA_HISR_TCIF6) {
         DMA1->HIFCR = DMA_HIFCR_CTCIF6;
 
+        if (sending_event == EVENT_STATS) {
+            stats_pending = 0;
+        }
+
         if (!is_queue_empty()) {
             send_to_DMA1(queue_poll());
         }
     }
 }
 
+static
+void receive_command(void) {
+    DMA1_Stream5->M0AR = (uint32_t) &command;
+    DMA1_Stream5->NDTR = 1;
+    DMA1_Stream5->CR |= DMA_SxCR_EN;
+}
+
+static
+void handle_command(void) {
+    if (command == COMMAND_QUERY_STATS) {
+        if (!stats_pending) {
+            format_stats();
+            stats_pending = 1;
+            send(EVENT_STATS);
+        }
+    } else if (command == COMMAND_RESET_STATS) {
+        messages.enqueued = 0;
+        messages.dropped = 0;
+        messages.high_water = messages.used;
+    } else if (command == COMMAND_POLICY_DROP_NEWEST) {
+        messages.policy = POLICY_DROP_NEWEST;
+    } else if (command == COMMAND_POLICY_DROP_OLDEST) {
+        messages.policy = POLICY_DROP_OLDEST;
+    } else if (command == COMMAND_POLICY_COALESCE) {
+        messages.policy = POLICY_COALESCE;
+    }
+}
+
+void DMA1_Stream5_IRQHandler(void) {
+    uint32_t isr = DMA1->HISR;
+
+    if (isr & DMA_HISR_TCIF5) {
+        DMA1->HIFCR = DMA_HIFCR_CTCIF5;
+
+        handle_command();
+        receive_command();
+    }
+}
+
 void EXTI0_IRQHandler(void) {
     uint32_t interrupt_state = EXTI->PR;
     interrupt_handler(interrupt_state, EXTI_PR_PR0, &controller_buttons[6]);
@@ -246,6 +406,8 @@ int main(void) {
 
     USART2->CR1 |= USART_CR1_UE;
 
+    receive_command();
+
     for (;;) {}
 
     return 0;